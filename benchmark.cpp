@@ -1,17 +1,50 @@
 #include <algorithm>
+#include <bit>
 #include <chrono>
+#include <cmath>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <cstdint>
+#include <cstdio>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "hcs.hpp"
+#include "hcs_view.hpp"
+
+enum class access_pattern {
+    uniform,
+    zipf,
+    sequential,
+    trace
+};
+
+struct sampling_options {
+    access_pattern pattern = access_pattern::uniform;
+    std::uint64_t seed = std::random_device()();
+    double zipf_exponent = 1.0;
+    const char* trace_filename = nullptr;
+};
 
-std::vector<std::size_t> generate_sampling_positions(const std::size_t n, const std::size_t sz) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+std::vector<std::size_t> generate_uniform_positions(const std::size_t n, const std::size_t sz, std::mt19937_64& gen) {
     std::uniform_int_distribution<std::size_t> distribution(0, sz - 1);
 
     std::vector<std::size_t> sampling_positions;
@@ -23,14 +56,199 @@ std::vector<std::size_t> generate_sampling_positions(const std::size_t n, const
     return sampling_positions;
 }
 
-double extract_benchmark(const hcs& d, const std::size_t input_sz, const std::size_t n) {
-    const auto sampling_positions = generate_sampling_positions(n, input_sz);
+// Samples ids with the probability of the id of rank r proportional to
+// 1 / r^exponent. Ranks are assigned to ids in random order, so that the
+// hot sets are not just the dense roots at the lowest ids.
+std::vector<std::size_t> generate_zipf_positions(const std::size_t n,
+                                                 const std::size_t sz,
+                                                 const double exponent,
+                                                 std::mt19937_64& gen) {
+    std::vector<std::size_t> ids(sz);
+    for (std::size_t i = 0; i < sz; ++i) {
+        ids[i] = i;
+    }
+    std::shuffle(ids.begin(), ids.end(), gen);
+
+    std::vector<double> cumulative(sz);
+    double total = 0.0;
+    for (std::size_t r = 0; r < sz; ++r) {
+        total += 1.0 / std::pow(r + 1, exponent);
+        cumulative[r] = total;
+    }
+
+    std::uniform_real_distribution<double> distribution(0.0, total);
+
+    std::vector<std::size_t> sampling_positions;
+    sampling_positions.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const auto r = std::lower_bound(cumulative.begin(), cumulative.end(), distribution(gen)) - cumulative.begin();
+        sampling_positions.push_back(ids[std::min<std::size_t>(r, sz - 1)]);
+    }
+
+    return sampling_positions;
+}
+
+// Consecutive ids from a random start, wrapping around at the end.
+std::vector<std::size_t> generate_sequential_positions(const std::size_t n, const std::size_t sz, std::mt19937_64& gen) {
+    const std::size_t first = std::uniform_int_distribution<std::size_t>(0, sz - 1)(gen);
+
+    std::vector<std::size_t> sampling_positions;
+    sampling_positions.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        sampling_positions.push_back((first + i) % sz);
+    }
+
+    return sampling_positions;
+}
+
+// A trace has the format of the parents file: one int64 per access. Its ids
+// are input ids mapped through the id map of the index if it has one, and
+// hcs ids otherwise. The trace is replayed until n accesses are made, or
+// once if n is 0.
+template<typename Index>
+std::vector<std::size_t> read_trace_positions(const std::size_t n, const char* trace_filename, const Index& d) {
+    std::ifstream ifs(trace_filename, std::ios::binary);
+    if (!ifs) {
+        throw std::runtime_error(std::string("cannot open ") + trace_filename);
+    }
+
+    std::vector<std::size_t> trace;
+    std::int64_t id = 0;
+    while (ifs.read(reinterpret_cast<char*>(&id), sizeof(id))) {
+        if (id < 0 || id >= d.input_count()) {
+            throw std::runtime_error(std::string(trace_filename) + ": id " + std::to_string(id) + " out of range");
+        }
+        trace.push_back(d.hcs_id(id));
+    }
+    ifs.close();
+
+    if (trace.empty()) {
+        throw std::runtime_error(std::string(trace_filename) + ": empty trace");
+    }
+
+    std::vector<std::size_t> sampling_positions;
+    sampling_positions.reserve(n ? n : trace.size());
+    for (std::size_t i = 0; i < (n ? n : trace.size()); ++i) {
+        sampling_positions.push_back(trace[i % trace.size()]);
+    }
+
+    return sampling_positions;
+}
+
+// Uniform and Zipf ids are input ids mapped through the id map of the index
+// if it has one, so that files with different id layouts of the same sets
+// are benchmarked on the same sets. Sequential ids are hcs ids, so that
+// they scan the containers in the order of the layout.
+template<typename Index>
+std::vector<std::size_t> generate_sampling_positions(const sampling_options& options, const std::size_t n, const Index& d) {
+    std::mt19937_64 gen(options.seed);
+    std::vector<std::size_t> positions;
+
+    switch (options.pattern) {
+    case access_pattern::zipf:
+        positions = generate_zipf_positions(n, d.size(), options.zipf_exponent, gen);
+        break;
+    case access_pattern::sequential:
+        return generate_sequential_positions(n, d.size(), gen);
+    case access_pattern::trace:
+        return read_trace_positions(n, options.trace_filename, d);
+    default:
+        positions = generate_uniform_positions(n, d.size(), gen);
+    }
+
+    if (d.has_id_map() && d.input_count() == d.size()) {
+        for (auto& pos : positions) {
+            pos = d.hcs_id(pos);
+        }
+    }
+
+    return positions;
+}
+
+enum class perf_event {
+    cache_misses,
+    l1d_read_misses
+};
+
+// Hardware event counter of the calling thread. Without Linux perf events,
+// or if perf_event_paranoid forbids them, the counter is unavailable and
+// stop returns -1.
+class perf_counter {
+public:
+    explicit perf_counter(const perf_event event) {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        if (event == perf_event::cache_misses) {
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        } else {
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    perf_counter(const perf_counter&) = delete;
+    perf_counter& operator=(const perf_counter&) = delete;
+
+    ~perf_counter() {
+#ifdef __linux__
+        if (fd != -1) {
+            close(fd);
+        }
+#endif
+    }
+
+    void start() {
+#ifdef __linux__
+        if (fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    std::int64_t stop() {
+#ifdef __linux__
+        std::uint64_t count = 0;
+        if (fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+                return count;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+    int fd = -1;
+};
+
+static double elapsed_since(const std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+template<typename Index>
+double extract_benchmark(const Index& d,
+                         const std::vector<std::size_t>& sampling_positions,
+                         std::vector<double>& latencies) {
+    latencies.clear();
 
     auto start = std::chrono::high_resolution_clock::now();
     std::uint32_t x = 0;
     for (const auto pos : sampling_positions) {
+        const auto access_start = std::chrono::high_resolution_clock::now();
         const auto res{d.extract(pos)};
-        x ^= res.back(); // in order to not optimize result away
+        if (!res.empty()) {
+            x ^= res.back(); // in order to not optimize result away
+        }
+        latencies.push_back(elapsed_since(access_start));
     }
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
@@ -40,22 +258,520 @@ double extract_benchmark(const hcs& d, const std::size_t input_sz, const std::si
     return duration.count();
 }
 
+template<typename Index>
+double extract_into_benchmark(const Index& d,
+                              const std::vector<std::size_t>& sampling_positions,
+                              std::vector<double>& latencies,
+                              std::vector<std::size_t>& cardinalities) {
+    extract_context ctx;
+    std::vector<std::uint32_t> res;
+    latencies.clear();
+    cardinalities.clear();
 
-int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::fprintf(stderr, "usage: %s [input file] [number of accesses]\n", argv[0]);
-        std::exit(EXIT_FAILURE);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::uint32_t x = 0;
+    for (const auto pos : sampling_positions) {
+        const auto access_start = std::chrono::high_resolution_clock::now();
+        d.extract_into(pos, ctx, res);
+        if (!res.empty()) {
+            x ^= res.back(); // in order to not optimize result away
+        }
+        latencies.push_back(elapsed_since(access_start));
+        cardinalities.push_back(res.size());
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "x: " << x << "\n";
+
+    return duration.count();
+}
+
+template<typename Index>
+double extract_cached_benchmark(const Index& d,
+                                const std::vector<std::size_t>& sampling_positions,
+                                decode_cache& cache,
+                                std::vector<double>& latencies) {
+    extract_context ctx;
+    std::vector<std::uint32_t> res;
+    latencies.clear();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::uint32_t x = 0;
+    for (const auto pos : sampling_positions) {
+        const auto access_start = std::chrono::high_resolution_clock::now();
+        d.extract_into(pos, ctx, res, cache);
+        if (!res.empty()) {
+            x ^= res.back(); // in order to not optimize result away
+        }
+        latencies.push_back(elapsed_since(access_start));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "x: " << x << "\n";
+    std::cout << "cache hits: " << cache.hits() << ", misses: " << cache.misses()
+              << ", bytes: " << cache.memory_usage() << "\n";
+
+    return duration.count();
+}
+
+template<typename Index>
+double extract_batch_benchmark(const Index& d,
+                               const std::vector<std::size_t>& sampling_positions,
+                               const std::size_t batch_size,
+                               std::vector<double>& latencies) {
+    const std::vector<std::int64_t> ids(sampling_positions.begin(), sampling_positions.end());
+    batch_context ctx;
+    std::vector<std::size_t> offsets;
+    std::vector<std::uint32_t> values;
+    latencies.clear();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::uint32_t x = 0;
+    for (std::size_t i = 0; i < ids.size(); i += batch_size) {
+        const auto batch_start = std::chrono::high_resolution_clock::now();
+        const std::size_t n = std::min(batch_size, ids.size() - i);
+        d.extract_batch(std::span<const std::int64_t>(ids.data() + i, n), ctx, offsets, values);
+        for (std::size_t j = 0; j < n; ++j) {
+            if (offsets[j + 1] > offsets[j]) {
+                x ^= values[offsets[j + 1] - 1]; // in order to not optimize result away
+            }
+        }
+        latencies.push_back(elapsed_since(batch_start));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "x: " << x << "\n";
+
+    return duration.count();
+}
+
+struct latency_stats {
+    std::size_t count = 0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+};
+
+// Sorts the latencies and returns their statistics.
+latency_stats compute_stats(std::vector<double>& latencies) {
+    latency_stats stats;
+    if (latencies.empty()) {
+        return stats;
     }
 
-    std::ifstream ifs(argv[1]);
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](const double q) {
+        return latencies[std::min(static_cast<std::size_t>(q * latencies.size()), latencies.size() - 1)];
+    };
+
+    stats.count = latencies.size();
+    for (const auto l : latencies) {
+        stats.mean += l;
+    }
+    stats.mean /= latencies.size();
+    stats.p50 = percentile(0.5);
+    stats.p99 = percentile(0.99);
+    stats.p999 = percentile(0.999);
+
+    return stats;
+}
+
+// Reports the total and mean time of the accesses and the percentiles of
+// the latencies, which are per access or per batch as given by unit.
+void report(const char* name,
+            const double duration,
+            const std::size_t accesses,
+            std::vector<double>& latencies,
+            const char* unit = "access") {
+    std::cout << name << ": " << accesses << " accesses took: " <<  duration << " seconds\n";
+    std::cout << name << ": average time per access: " <<  duration / static_cast<double>(accesses) << " seconds\n";
+
+    if (latencies.empty()) {
+        return;
+    }
+
+    const auto stats = compute_stats(latencies);
+    std::cout << name << ": time per " << unit << " p50: " << stats.p50
+              << " p99: " << stats.p99
+              << " p999: " << stats.p999 << " seconds\n";
+}
+
+struct breakdown_row {
+    std::string group;
+    std::string bucket;
+    latency_stats stats;
+};
+
+// Results of one index for the comparison table and the JSON output.
+struct index_result {
+    std::string filename;
+    std::int64_t size_in_bytes = 0;
+    latency_stats total;
+    std::vector<breakdown_row> rows;
+
+    // per extract_into access, negative if the counters are unavailable
+    double cache_misses = -1;
+    double l1d_misses = -1;
+};
+
+// Splits the extract_into latencies by the category of the set, its depth
+// and its cardinality rounded down to a power of two.
+template<typename Index>
+std::vector<breakdown_row> latency_breakdown(const Index& d,
+                                             const std::vector<std::size_t>& sampling_positions,
+                                             const std::vector<double>& latencies,
+                                             const std::vector<std::size_t>& cardinalities) {
+    enum group { category, depth, cardinality };
+    static const char* group_names[] = {"category", "depth", "cardinality"};
+    static const char* category_names[] = {"dense", "sparse", "coded", "subset", "delta"};
+
+    // ordered by group and then by bucket
+    std::map<std::pair<int, std::size_t>, std::vector<double>> buckets;
+    for (std::size_t i = 0; i < sampling_positions.size(); ++i) {
+        const std::int64_t pos = sampling_positions[i];
+        const std::size_t kind = d.is_dense(pos) ? 0 : (d.is_sparse(pos) ? 1 : (d.is_coded(pos) ? 2 : (d.is_subset(pos) ? 3 : 4)));
+
+        buckets[{category, kind}].push_back(latencies[i]);
+        buckets[{depth, d.depth(pos)}].push_back(latencies[i]);
+        buckets[{cardinality, std::bit_width(cardinalities[i])}].push_back(latencies[i]);
+    }
+
+    std::vector<breakdown_row> rows;
+    for (auto& [key, bucket_latencies] : buckets) {
+        const auto [g, b] = key;
+
+        std::string bucket;
+        if (g == category) {
+            bucket = category_names[b];
+        } else if (g == depth) {
+            bucket = std::to_string(b);
+        } else {
+            // bit width b holds the cardinalities in [2^(b-1), 2^b)
+            bucket = (b <= 1) ? std::to_string(b) : std::to_string(1ull << (b - 1)) + "-" + std::to_string((1ull << b) - 1);
+        }
+
+        rows.push_back({group_names[g], bucket, compute_stats(bucket_latencies)});
+    }
+
+    return rows;
+}
+
+void print_breakdown(const index_result& result) {
+    std::cout << "extract_into latency breakdown of " << result.filename << " (seconds):\n";
+    std::cout << std::setw(12) << "group" << std::setw(14) << "bucket" << std::setw(10) << "accesses"
+              << std::setw(14) << "mean" << std::setw(14) << "p50" << std::setw(14) << "p99" << "\n";
+    for (const auto& row : result.rows) {
+        std::cout << std::setw(12) << row.group << std::setw(14) << row.bucket << std::setw(10) << row.stats.count
+                  << std::setw(14) << row.stats.mean << std::setw(14) << row.stats.p50 << std::setw(14) << row.stats.p99 << "\n";
+    }
+}
+
+// s as a quoted JSON string, with quotes, backslashes and control
+// characters escaped
+std::string json_string(const std::string& s) {
+    std::string quoted = "\"";
+    for (const char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned char>(c));
+            quoted += escaped;
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += '"';
+
+    return quoted;
+}
+
+void write_json(const char* json_filename, const std::vector<index_result>& results) {
+    std::ofstream ofs(json_filename);
+
+    const auto stats_json = [&](const latency_stats& stats) {
+        ofs << "{\"accesses\": " << stats.count << ", \"mean\": " << stats.mean << ", \"p50\": " << stats.p50
+            << ", \"p99\": " << stats.p99 << ", \"p999\": " << stats.p999 << "}";
+    };
+
+    ofs << "[\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        ofs << "  {\"file\": " << json_string(result.filename) << ", \"size_in_bytes\": " << result.size_in_bytes
+            << ", \"cache_misses\": " << result.cache_misses << ", \"l1d_misses\": " << result.l1d_misses << ", \"extract_into\": ";
+        stats_json(result.total);
+        ofs << ",\n   \"breakdown\": [\n";
+        for (std::size_t r = 0; r < result.rows.size(); ++r) {
+            const auto& row = result.rows[r];
+            ofs << "    {\"group\": " << json_string(row.group) << ", \"bucket\": " << json_string(row.bucket) << ", \"stats\": ";
+            stats_json(row.stats);
+            ofs << "}" << (r + 1 < result.rows.size() ? "," : "") << "\n";
+        }
+        ofs << "   ]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    ofs << "]\n";
+
+    ofs.close();
+}
+
+// Runs extract_into concurrently on threads sharing d, and cache if given,
+// each thread with its own context and its own ids drawn with the seed plus
+// the thread number. Reports the aggregate throughput and a histogram of
+// the latencies of every thread in power-of-two ranges of nanoseconds.
+template<typename Index>
+void threaded_benchmark(const char* name,
+                        const Index& d,
+                        const std::size_t accesses,
+                        const std::size_t threads,
+                        const sampling_options& options,
+                        decode_cache* cache) {
+    std::vector<std::vector<std::size_t>> sampling_positions(threads);
+    for (std::size_t t = 0; t < threads; ++t) {
+        sampling_options thread_options = options;
+        thread_options.seed = options.seed + t;
+        sampling_positions[t] = generate_sampling_positions(thread_options, accesses, d);
+    }
+
+    std::vector<std::vector<double>> latencies(threads);
+    std::uint32_t x = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    #pragma omp parallel num_threads(threads) reduction(^:x)
+    {
+#ifdef _OPENMP
+        const std::size_t t = omp_get_thread_num();
+#else
+        const std::size_t t = 0;
+#endif
+        extract_context ctx;
+        std::vector<std::uint32_t> res;
+        auto& thread_latencies = latencies[t];
+        thread_latencies.reserve(sampling_positions[t].size());
+
+        for (const auto pos : sampling_positions[t]) {
+            const auto access_start = std::chrono::high_resolution_clock::now();
+            if (cache) {
+                d.extract_into(pos, ctx, res, *cache);
+            } else {
+                d.extract_into(pos, ctx, res);
+            }
+            if (!res.empty()) {
+                x ^= res.back(); // in order to not optimize result away
+            }
+            thread_latencies.push_back(elapsed_since(access_start));
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "x: " << x << "\n";
+
+    // threads that did not run, e.g. without OpenMP, are left out
+    std::size_t total = 0;
+    std::size_t active = 0;
+    for (const auto& thread_latencies : latencies) {
+        total += thread_latencies.size();
+        active += !thread_latencies.empty();
+    }
+
+    std::cout << name << ": " << active << " threads made " << total << " accesses in " << duration.count() << " seconds\n";
+    std::cout << name << ": throughput: " << total / duration.count() << " accesses per second\n";
+    if (cache) {
+        std::cout << name << ": cache hits: " << cache->hits() << ", misses: " << cache->misses() << "\n";
+    }
+
+    // bucket b holds the latencies in [2^(b-1), 2^b) nanoseconds
+    const auto bucket_of = [](const double latency) {
+        return static_cast<std::size_t>(std::bit_width(static_cast<std::uint64_t>(latency * 1e9)));
+    };
+
+    std::size_t first_bucket = 64;
+    std::size_t last_bucket = 0;
+    std::vector<std::vector<std::size_t>> histograms(threads, std::vector<std::size_t>(65, 0));
+    for (std::size_t t = 0; t < threads; ++t) {
+        for (const auto l : latencies[t]) {
+            const auto b = bucket_of(l);
+            ++histograms[t][b];
+            first_bucket = std::min(first_bucket, b);
+            last_bucket = std::max(last_bucket, b);
+        }
+    }
+
+    std::cout << name << ": latencies per thread (accesses per range of nanoseconds, p50 and p99 in seconds):\n";
+    std::cout << std::setw(8) << "thread";
+    for (std::size_t b = first_bucket; b <= last_bucket; ++b) {
+        std::cout << std::setw(10) << ("<" + std::to_string(1ull << b));
+    }
+    std::cout << std::setw(14) << "p50" << std::setw(14) << "p99" << "\n";
+
+    for (std::size_t t = 0; t < threads; ++t) {
+        if (latencies[t].empty()) {
+            continue;
+        }
+
+        const auto stats = compute_stats(latencies[t]);
+        std::cout << std::setw(8) << t;
+        for (std::size_t b = first_bucket; b <= last_bucket; ++b) {
+            std::cout << std::setw(10) << histograms[t][b];
+        }
+        std::cout << std::setw(14) << stats.p50 << std::setw(14) << stats.p99 << "\n";
+    }
+}
+
+template<typename Index>
+index_result run_benchmarks(const Index& d,
+                            const std::size_t accesses,
+                            const std::size_t batch_size,
+                            const std::size_t cache_bytes,
+                            const std::size_t threads,
+                            const sampling_options& options) {
+    const auto sampling_positions = generate_sampling_positions(options, accesses, d);
+    const std::size_t n = sampling_positions.size();
+    std::vector<double> latencies;
+    std::vector<std::size_t> cardinalities;
+
+    index_result result;
+    result.size_in_bytes = d.size_in_bytes();
+
+    report("extract", extract_benchmark(d, sampling_positions, latencies), n, latencies);
+
+    perf_counter cache_misses(perf_event::cache_misses);
+    perf_counter l1d_misses(perf_event::l1d_read_misses);
+    cache_misses.start();
+    l1d_misses.start();
+    const double into_duration = extract_into_benchmark(d, sampling_positions, latencies, cardinalities);
+    const auto l1d_count = l1d_misses.stop();
+    const auto cache_count = cache_misses.stop();
+
+    result.rows = latency_breakdown(d, sampling_positions, latencies, cardinalities);
+    report("extract_into", into_duration, n, latencies);
+    result.total = compute_stats(latencies);
+
+    if (cache_count >= 0 && n) {
+        result.cache_misses = static_cast<double>(cache_count) / n;
+        result.l1d_misses = (l1d_count >= 0) ? static_cast<double>(l1d_count) / n : -1;
+        std::cout << "extract_into: cache misses per access: " << result.cache_misses
+                  << " L1d read misses per access: " << result.l1d_misses << "\n";
+    } else {
+        std::cout << "extract_into: cache miss counters unavailable\n";
+    }
+
+    report("extract_batch", extract_batch_benchmark(d, sampling_positions, batch_size, latencies), n, latencies, "batch");
+
+    decode_cache cache(cache_bytes);
+    report("extract_cached", extract_cached_benchmark(d, sampling_positions, cache, latencies), n, latencies);
+
+    if (threads > 1) {
+        threaded_benchmark("extract_into (threads)", d, accesses, threads, options, nullptr);
+
+        cache.clear();
+        threaded_benchmark("extract_cached (threads)", d, accesses, threads, options, &cache);
+    }
+
+    return result;
+}
+
+index_result benchmark_file(const char* input_filename,
+                            const std::size_t accesses,
+                            const std::size_t batch_size,
+                            const std::size_t cache_bytes,
+                            const std::size_t threads,
+                            const sampling_options& options) {
+    std::cout << "HCS file: " << input_filename << "\n";
+
+    if (is_mapped_hcs(input_filename)) {
+        std::cout << "mapped HCS file\n";
+        const hcs_view d(input_filename);
+        return run_benchmarks(d, accesses, batch_size, cache_bytes, threads, options);
+    }
+
+    std::ifstream ifs(input_filename);
 
     hcs d;
     d.load(ifs);
     ifs.close();
 
-    const std::size_t accesses = std::stoull(argv[2]);
+    return run_benchmarks(d, accesses, batch_size, cache_bytes, threads, options);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<const char*> positional;
+    std::vector<const char*> compared;
+    const char* json_filename = nullptr;
+    std::size_t threads = 1;
+    sampling_options options;
+
+    bool valid = true;
+    for (int i = 1; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::stoull(argv[++i]);
+        } else if (arg == "--zipf" && i + 1 < argc) {
+            options.pattern = access_pattern::zipf;
+            options.zipf_exponent = std::stod(argv[++i]);
+        } else if (arg == "--sequential") {
+            options.pattern = access_pattern::sequential;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.pattern = access_pattern::trace;
+            options.trace_filename = argv[++i];
+        } else if (arg == "--compare" && i + 1 < argc) {
+            compared.push_back(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::max<std::size_t>(std::stoull(argv[++i]), 1);
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_filename = argv[++i];
+        } else if (arg.rfind("--", 0) != 0) {
+            positional.push_back(argv[i]);
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid || positional.size() < 2 || positional.size() > 4) {
+        std::fprintf(stderr, "usage: %s [input file] [number of accesses] [batch size (default 1024)] [cache MiB (default 64)] "
+                             "[--seed N] [--zipf exponent | --sequential | --trace file] [--compare HCS file]... [--json file] [--threads N]\n", argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+    const char* input_filename = positional[0];
+    const std::size_t accesses = std::stoull(positional[1]);
+    const std::size_t batch_size = (positional.size() >= 3) ? std::stoull(positional[2]) : 1024;
+    const std::size_t cache_bytes = ((positional.size() >= 4) ? std::stoull(positional[3]) : 64) << 20;
+    std::cout << "subset kernel: " << deposit_subset_kernel() << "\n";
+    std::cout << "emit kernel: " << emit_positions_kernel() << "\n";
+    std::cout << "seed: " << options.seed << "\n";
 
-    const auto duration = extract_benchmark(d, d.size(), accesses);
-    std::cout << accesses << " accesses took: " <<  duration << " seconds\n";
-    std::cout << "average time per access: " <<  duration / static_cast<double>(accesses) << " seconds\n";
+    // every index samples the same ids for the seed
+    compared.insert(compared.begin(), input_filename);
+
+    std::vector<index_result> results;
+    for (const auto filename : compared) {
+        results.push_back(benchmark_file(filename, accesses, batch_size, cache_bytes, threads, options));
+        results.back().filename = filename;
+        print_breakdown(results.back());
+    }
+
+    if (results.size() > 1) {
+        std::cout << "extract_into comparison (seconds):\n";
+        std::cout << std::setw(32) << "file" << std::setw(16) << "bytes" << std::setw(14) << "mean"
+                  << std::setw(14) << "p50" << std::setw(14) << "p99"
+                  << std::setw(14) << "misses" << std::setw(14) << "L1d misses" << "\n";
+        for (const auto& result : results) {
+            std::cout << std::setw(32) << result.filename << std::setw(16) << result.size_in_bytes
+                      << std::setw(14) << result.total.mean << std::setw(14) << result.total.p50
+                      << std::setw(14) << result.total.p99
+                      << std::setw(14) << result.cache_misses << std::setw(14) << result.l1d_misses << "\n";
+        }
+    }
+
+    if (json_filename) {
+        write_json(json_filename, results);
+    }
 }
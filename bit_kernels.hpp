@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+
+#include <cstdint>
+
+#include <sdsl/bits.hpp>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define HCS_X86_DISPATCH 1
+#endif
+
+// Kernels for applying one subset of a chain to the decoded bit vector of
+// its ancestor. The i-th set bit of the ancestor words is kept if and only
+// if the i-th subset bit starting from elem is set. Every kernel returns the
+// position of the first subset bit after the consumed ones.
+
+static inline std::size_t deposit_subset_scalar(std::uint64_t* words,
+                                                const std::size_t word_count,
+                                                const std::uint64_t* subset,
+                                                std::size_t elem) {
+    for (std::size_t w = 0; w < word_count; ++w) {
+        const std::uint64_t bits = std::popcount(words[w]);
+        std::uint64_t mask = ~0ull;
+        std::uint64_t temp = 0ull;
+        for (std::uint64_t b = 1; (b <= bits); ++b) {
+            const std::uint64_t bit_idx = std::countr_zero(words[w] & mask);
+            const std::uint64_t bit = (subset[elem / 64] >> (elem % 64)) & 1;
+            ++elem;
+            temp |= (bit << bit_idx);
+            mask &= ~(1ull << bit_idx);
+        }
+        words[w] = temp;
+    }
+
+    return elem;
+}
+
+#ifdef HCS_X86_DISPATCH
+// Reads all subset bits of a word at once and scatters them to the set
+// positions of the word with a single PDEP.
+__attribute__((target("bmi2,popcnt")))
+static std::size_t deposit_subset_pdep(std::uint64_t* words,
+                                       const std::size_t word_count,
+                                       const std::uint64_t* subset,
+                                       std::size_t elem) {
+    for (std::size_t w = 0; w < word_count; ++w) {
+        const std::uint64_t word = words[w];
+        const std::uint8_t bits = std::popcount(word);
+        if (bits) {
+            const std::uint64_t subset_bits = sdsl::bits::read_int(subset + elem / 64, elem % 64, bits);
+            words[w] = _pdep_u64(subset_bits, word);
+            elem += bits;
+        }
+    }
+
+    return elem;
+}
+#endif
+
+using deposit_subset_fn = std::size_t (*)(std::uint64_t*, std::size_t, const std::uint64_t*, std::size_t);
+
+static inline bool has_fast_pdep() {
+#ifdef HCS_X86_DISPATCH
+    __builtin_cpu_init();
+    // PDEP is microcoded and slower than the scalar loop on AMD before Zen 3
+    if (__builtin_cpu_is("bdver4") || __builtin_cpu_is("znver1") || __builtin_cpu_is("znver2")) {
+        return false;
+    }
+    return __builtin_cpu_supports("bmi2");
+#else
+    return false;
+#endif
+}
+
+static inline deposit_subset_fn select_deposit_subset() {
+#ifdef HCS_X86_DISPATCH
+    if (has_fast_pdep()) {
+        return deposit_subset_pdep;
+    }
+#endif
+    return deposit_subset_scalar;
+}
+
+static inline std::size_t deposit_subset(std::uint64_t* words,
+                                         const std::size_t word_count,
+                                         const std::uint64_t* subset,
+                                         const std::size_t elem) {
+    static const deposit_subset_fn fn = select_deposit_subset();
+    return fn(words, word_count, subset, elem);
+}
+
+static inline const char* deposit_subset_kernel() {
+    return has_fast_pdep() ? "pdep" : "scalar";
+}
+
+// Number of set bits in positions [beg, end) of words.
+static inline std::size_t popcount_range(const std::uint64_t* words, std::size_t beg, const std::size_t end) {
+    std::size_t count = 0;
+    while (beg < end) {
+        const std::size_t len = std::min<std::size_t>(64 - beg % 64, end - beg);
+        const std::uint64_t word = words[beg / 64] >> (beg % 64);
+        count += std::popcount(len == 64 ? word : word & ((1ull << len) - 1));
+        beg += len;
+    }
+
+    return count;
+}
+
+// Kernels for listing the set bits in positions [beg, end) of words, which
+// need not be word aligned. The positions relative to beg are written to
+// out in ascending order and their number is returned; out must have room
+// for popcount_range(words, beg, end) positions.
+
+static inline std::size_t emit_positions_scalar(const std::uint64_t* words,
+                                                const std::size_t beg,
+                                                const std::size_t end,
+                                                std::uint32_t* out) {
+    std::size_t n = 0;
+    for (std::size_t p = beg; p < end; p += 64) {
+        std::uint64_t word = sdsl::bits::read_int(words + p / 64, p % 64, std::min<std::size_t>(64, end - p));
+        const std::uint32_t base = p - beg;
+        while (word) {
+            out[n++] = base + std::countr_zero(word);
+            word &= word - 1;
+        }
+    }
+
+    return n;
+}
+
+#ifdef HCS_X86_DISPATCH
+// Writes the positions of 16 bits at a time with one VPCOMPRESSD from a
+// vector of consecutive positions. Sparse words take the scalar loop.
+__attribute__((target("avx512f,popcnt")))
+static std::size_t emit_positions_avx512(const std::uint64_t* words,
+                                         const std::size_t beg,
+                                         const std::size_t end,
+                                         std::uint32_t* out) {
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    std::size_t n = 0;
+    for (std::size_t p = beg; p < end; p += 64) {
+        std::uint64_t word = sdsl::bits::read_int(words + p / 64, p % 64, std::min<std::size_t>(64, end - p));
+        const std::uint32_t base = p - beg;
+
+        if (std::popcount(word) < 8) {
+            while (word) {
+                out[n++] = base + std::countr_zero(word);
+                word &= word - 1;
+            }
+            continue;
+        }
+
+        for (std::uint32_t c = 0; c < 64; c += 16) {
+            const __mmask16 mask = word >> c;
+            const __m512i positions = _mm512_add_epi32(lanes, _mm512_set1_epi32(base + c));
+            _mm512_mask_compressstoreu_epi32(out + n, mask, positions);
+            n += std::popcount(static_cast<std::uint16_t>(mask));
+        }
+    }
+
+    return n;
+}
+#endif
+
+using emit_positions_fn = std::size_t (*)(const std::uint64_t*, std::size_t, std::size_t, std::uint32_t*);
+
+static inline bool has_avx512() {
+#ifdef HCS_X86_DISPATCH
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+#else
+    return false;
+#endif
+}
+
+static inline emit_positions_fn select_emit_positions() {
+#ifdef HCS_X86_DISPATCH
+    if (has_avx512()) {
+        return emit_positions_avx512;
+    }
+#endif
+    return emit_positions_scalar;
+}
+
+static inline std::size_t emit_positions(const std::uint64_t* words,
+                                         const std::size_t beg,
+                                         const std::size_t end,
+                                         std::uint32_t* out) {
+    static const emit_positions_fn fn = select_emit_positions();
+    return fn(words, beg, end, out);
+}
+
+static inline const char* emit_positions_kernel() {
+    return has_avx512() ? "avx512" : "scalar";
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+#include "mapped_file.hpp"
+
+// Color sets in the binary format of themisto
+// dump-distinct-color-sets-to-binary: every set is its size followed by its
+// colors in ascending order, all as 32-bit integers. The words are memory
+// mapped from the file (or owned when built in memory) and the sets are
+// located through one offset per set, so sets are read in place without
+// per-set allocations.
+class color_set_collection {
+public:
+    using set_type = std::span<const std::uint32_t>;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = set_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = set_type;
+
+        const_iterator() {}
+
+        const_iterator(const color_set_collection* c, const std::size_t i)
+            : c(c), i(i) {}
+
+        set_type operator*() const {
+            return (*c)[i];
+        }
+
+        const_iterator& operator++() {
+            ++i;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto it = *this;
+            ++i;
+            return it;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return i == other.i;
+        }
+
+    private:
+        const color_set_collection* c = nullptr;
+        std::size_t i = 0;
+    };
+
+    color_set_collection() {}
+
+    // advice is passed to madvise for the mapping before the sets are
+    // indexed, e.g. MADV_WILLNEED to read the file ahead of the index
+    explicit color_set_collection(const char* input_filename, const int advice = MADV_NORMAL)
+        : file(input_filename) {
+        file.advise(advice);
+        if (file.size() % sizeof(std::uint32_t) != 0) {
+            throw std::runtime_error(std::string(input_filename) + ": size is not a multiple of 4 bytes");
+        }
+
+        words = reinterpret_cast<const std::uint32_t*>(file.data());
+        word_count = file.size() / sizeof(std::uint32_t);
+        index_sets();
+    }
+
+    // Takes ownership of words in the binary format.
+    explicit color_set_collection(std::vector<std::uint32_t>&& owned_words)
+        : owned(std::move(owned_words)) {
+        words = owned.data();
+        word_count = owned.size();
+        index_sets();
+    }
+
+    color_set_collection(color_set_collection&&) = default;
+    color_set_collection& operator=(color_set_collection&&) = default;
+
+    std::size_t size() const {
+        return starts.size();
+    }
+
+    bool empty() const {
+        return starts.empty();
+    }
+
+    set_type operator[](const std::size_t i) const {
+        const std::size_t start = starts[i];
+        return set_type(words + start + 1, words[start]);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    // word offset of the size of the i-th set in the binary format
+    std::size_t word_offset(const std::size_t i) const {
+        return starts[i];
+    }
+
+    // Makes the set order[i] the i-th set. The sets stay in place, only
+    // the offsets are permuted.
+    void reorder(const std::vector<std::int64_t>& order) {
+        std::vector<std::size_t> reordered(order.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            reordered[i] = starts[order[i]];
+        }
+        starts = std::move(reordered);
+    }
+
+    // number of colors over all sets
+    std::size_t element_count() const {
+        return word_count - starts.size();
+    }
+
+private:
+    void index_sets() {
+        std::size_t i = 0;
+        while (i < word_count) {
+            starts.push_back(i);
+            i += static_cast<std::size_t>(words[i]) + 1;
+        }
+
+        if (i != word_count) {
+            throw std::runtime_error("truncated color set file");
+        }
+    }
+
+    mapped_file file;
+    std::vector<std::uint32_t> owned;
+    const std::uint32_t* words = nullptr;
+    std::size_t word_count = 0;
+    std::vector<std::size_t> starts;
+};
+
+// Indices of the sets in ascending order of size. Sets of equal size keep
+// their order, so that sorting the sets of an input file gives the order
+// file of sort_asc.
+static inline std::vector<std::int64_t> order_by_size(const color_set_collection& color_sets) {
+    std::vector<std::int64_t> order(color_sets.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const std::int64_t a, const std::int64_t b) {
+        return color_sets[a].size() < color_sets[b].size();
+    });
+
+    return order;
+}
+
+// Writes the sets in the binary format.
+static inline void write_color_sets(const char* output_filename, const color_set_collection& color_sets) {
+    std::ofstream ofs(output_filename, std::ios::binary);
+    for (const auto color_set : color_sets) {
+        const std::uint32_t color_set_sz = color_set.size();
+        ofs.write(reinterpret_cast<const char*>(&color_set_sz), sizeof(color_set_sz));
+        ofs.write(reinterpret_cast<const char*>(color_set.data()), sizeof(std::uint32_t) * color_set_sz);
+    }
+    ofs.close();
+}
+
+// Sequential reader of the color sets of a file in the binary format of
+// color_set_collection that keeps only one block of the file in memory.
+class color_set_reader {
+public:
+    using set_type = std::span<const std::uint32_t>;
+
+    explicit color_set_reader(const char* input_filename, const std::size_t block_words = std::size_t(1) << 20)
+        : ifs(input_filename, std::ios::binary), buffer(block_words) {
+        if (!ifs) {
+            throw std::runtime_error(std::string("cannot open ") + input_filename);
+        }
+    }
+
+    // Reads the next set into set, which stays valid until the next call.
+    // Returns false at the end of the file.
+    bool next(set_type& set) {
+        if (!fill(1)) {
+            return false;
+        }
+
+        const std::size_t sz = buffer[pos];
+        if (!fill(sz + 1)) {
+            throw std::runtime_error("truncated color set file");
+        }
+
+        set = set_type(buffer.data() + pos + 1, sz);
+        pos += sz + 1;
+
+        return true;
+    }
+
+private:
+    // Makes at least needed words available from pos, moving the unread
+    // words to the front of the buffer and growing it for large sets.
+    bool fill(const std::size_t needed) {
+        if (filled - pos >= needed) {
+            return true;
+        }
+
+        std::copy(buffer.begin() + pos, buffer.begin() + filled, buffer.begin());
+        filled -= pos;
+        pos = 0;
+
+        if (buffer.size() < needed) {
+            buffer.resize(needed);
+        }
+
+        ifs.read(reinterpret_cast<char*>(buffer.data() + filled), (buffer.size() - filled) * sizeof(std::uint32_t));
+        filled += ifs.gcount() / sizeof(std::uint32_t);
+
+        return filled >= needed;
+    }
+
+    std::ifstream ifs;
+    std::vector<std::uint32_t> buffer;
+    std::size_t pos = 0;
+    std::size_t filled = 0;
+};
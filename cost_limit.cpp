@@ -0,0 +1,349 @@
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <numeric>
+
+#include "hcs_construction.hpp"
+
+// Number of ancestors on the chain of a set considered as its new parent.
+static constexpr std::int64_t max_jump = 64;
+
+// Serialized size, width and tag of a vector and the padding to a word.
+static constexpr std::size_t vector_overhead_bits = (8 + 1 + 8) * 8 + 63;
+
+// Vectors written by build_ds with the id map.
+static constexpr std::size_t vector_count = 11;
+
+// Builds over the budget after which the smallest one is kept.
+static constexpr int max_attempts = 4;
+
+struct frontier_point {
+    double lambda;
+    double space_bits;
+    double expected_cost;
+};
+
+// Encoding of every set as a root and bits of its mask as a subset of each
+// of its first max_jump ancestors, which do not depend on lambda and are
+// computed once for all explored points. The candidates of set i are
+// hop_starts[i] to hop_starts[i + 1] in the hop vectors.
+struct candidate_spaces {
+    std::vector<root_choice> roots;
+    std::vector<std::size_t> hop_starts;
+    std::vector<std::int64_t> hop_ancestors;
+    std::vector<std::size_t> hop_bits;
+};
+
+candidate_spaces compute_candidate_spaces(const color_set_collection& color_sets,
+                                          const std::vector<std::int64_t>& parents,
+                                          const std::int64_t enc_width) {
+    const std::int64_t n = color_sets.size();
+
+    candidate_spaces spaces;
+    spaces.roots.resize(n);
+    spaces.hop_starts.assign(n + 1, 0);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (std::int64_t i = 0; i < n; ++i) {
+        spaces.roots[i] = choose_root(color_sets[i], enc_width);
+
+        std::int64_t hops = 0;
+        for (auto ancestor = parents[i]; ancestor != -1 && hops < max_jump; ancestor = parents[ancestor]) {
+            ++hops;
+        }
+        spaces.hop_starts[i + 1] = hops;
+    }
+
+    std::partial_sum(spaces.hop_starts.begin(), spaces.hop_starts.end(), spaces.hop_starts.begin());
+    spaces.hop_ancestors.resize(spaces.hop_starts[n]);
+    spaces.hop_bits.resize(spaces.hop_starts[n]);
+
+    #pragma omp parallel for schedule(dynamic, 1024)
+    for (std::int64_t i = 0; i < n; ++i) {
+        auto ancestor = parents[i];
+        for (auto h = spaces.hop_starts[i]; h < spaces.hop_starts[i + 1]; ++h) {
+            spaces.hop_ancestors[h] = ancestor;
+            spaces.hop_bits[h] = subset_bits(color_sets[ancestor].size(), color_sets[i].size());
+            ancestor = parents[ancestor];
+        }
+    }
+
+    return spaces;
+}
+
+// Bits of the file build_ds writes for sets of each kind with the given
+// numbers of elements in their containers, counted like build_ds does: the
+// containers and their starts, the parent pointers and coded flags of the
+// subsets, the id map, the padding of the coded containers and the
+// overhead of every vector.
+double modelled_bits(const std::size_t (&counts)[4],
+                     const std::size_t (&elements)[4],
+                     const std::int64_t n,
+                     const std::int64_t enc_width) {
+    const auto dense = static_cast<std::size_t>(set_kind::dense);
+    const auto sparse = static_cast<std::size_t>(set_kind::sparse);
+    const auto coded = static_cast<std::size_t>(set_kind::coded);
+    const auto subset = static_cast<std::size_t>(set_kind::subset);
+    const std::size_t ptr_width = bits_required(n);
+
+    double bits = elements[dense] + elements[sparse] * enc_width + elements[coded] + elements[subset];
+    for (const auto kind : {dense, sparse, coded, subset}) {
+        bits += (counts[kind] + 1) * bits_required(elements[kind]);
+    }
+    bits += counts[subset] * (ptr_width + 1);
+    bits += n * ptr_width;
+
+    return bits + 2 * stream_padding_bits + vector_count * vector_overhead_bits;
+}
+
+// Bytes serialize writes for d.
+std::int64_t serialized_bytes(const hcs& d) {
+    std::int64_t bytes = 0;
+    d.visit_sections([&](const hcs_section tag, const char*, const auto& v) {
+        if (is_required(tag)) {
+            bytes += sdsl::size_in_bytes(v);
+        } else if (!v.empty()) {
+            bytes += sizeof(std::uint64_t) + sdsl::size_in_bytes(v);
+        }
+    });
+
+    return bytes;
+}
+
+// Chooses for every set whether it stays a subset of its parent, becomes a
+// subset of a higher ancestor on its chain or becomes a root, minimizing
+// weight * decode cost + lambda * space per set, and returns the resulting
+// point. The decode cost of a root is its size and the cost of a subset is
+// the cost of its ancestor plus the size of the ancestor, i.e. the number
+// of elements decoded on the chain; the space is modelled_bits. Parents precede children in descending order of index, so the
+// cost of every candidate ancestor is fixed when a set is processed. The
+// weight of a set is the query frequency of its subtree in the original
+// forest, an upper bound on the queries decoding through it.
+frontier_point cost_limit(const color_set_collection& color_sets,
+                          const candidate_spaces& spaces,
+                          const std::vector<double>& freqs,
+                          const std::vector<double>& weights,
+                          const std::int64_t enc_width,
+                          const double lambda,
+                          std::vector<std::int64_t>& anchors) {
+    const std::int64_t n = color_sets.size();
+    const std::size_t ptr_width = bits_required(color_sets.size());
+
+    std::vector<double> costs(n, 0.0);
+    anchors.assign(n, -1);
+
+    std::size_t counts[4] = {};
+    std::size_t elements[4] = {};
+    double total_cost = 0.0;
+    double total_freq = 0.0;
+
+    for (std::int64_t i = n - 1; i >= 0; --i) {
+        // an infinite lambda minimizes space alone
+        const auto score_of = [&](const double cost, const double space) {
+            return std::isinf(lambda) ? space : weights[i] * cost + lambda * space;
+        };
+
+        const auto root = spaces.roots[i];
+        double best_cost = color_sets[i].size();
+        double best_score = score_of(best_cost, root.bits);
+
+        // sparse roots are counted in elements like their starts
+        auto kind = root.kind;
+        std::size_t best_elements = (kind == set_kind::sparse) ? color_sets[i].size() : root.bits;
+
+        for (auto h = spaces.hop_starts[i]; h < spaces.hop_starts[i + 1]; ++h) {
+            const auto ancestor = spaces.hop_ancestors[h];
+            const double cost = costs[ancestor] + color_sets[ancestor].size();
+            const double score = score_of(cost, spaces.hop_bits[h] + ptr_width);
+
+            if (score < best_score) {
+                best_score = score;
+                best_cost = cost;
+                kind = set_kind::subset;
+                best_elements = spaces.hop_bits[h];
+                anchors[i] = ancestor;
+            }
+        }
+
+        costs[i] = best_cost;
+        ++counts[static_cast<std::size_t>(kind)];
+        elements[static_cast<std::size_t>(kind)] += best_elements;
+        total_cost += freqs[i] * best_cost;
+        total_freq += freqs[i];
+    }
+
+    return {lambda, modelled_bits(counts, elements, n, enc_width), total_freq > 0 ? total_cost / total_freq : 0.0};
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 5 && argc != 6 && argc != 7) {
+        std::fprintf(stderr, "usage: %s [color sets file] [parents file] [space budget in bytes] [output file] [order file] [frequency file]\n", argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+    const color_set_collection color_sets(argv[1]);
+    const auto parents = get_parents<std::int64_t>(argv[2]);
+    const double space_budget = std::stod(argv[3]) * 8;
+    const auto order = (argc >= 6) ? get_order<std::int64_t>(argv[5]) : std::vector<std::int64_t>();
+
+    const std::int64_t n = color_sets.size();
+
+    // query frequencies are indexed by input id like the id map
+    std::vector<double> freqs(n, 1.0);
+    if (argc == 7) {
+        const auto counts = get_parents<std::uint64_t>(argv[6]);
+        if (static_cast<std::int64_t>(counts.size()) != n) {
+            std::fprintf(stderr, "%s: expected %lld query counts, found %zu\n", argv[6], static_cast<long long>(n), counts.size());
+            std::exit(EXIT_FAILURE);
+        }
+        for (std::int64_t i = 0; i < n; ++i) {
+            freqs[i] = counts[order.empty() ? i : order[i]];
+        }
+    }
+
+    std::vector<double> weights(freqs);
+    for (std::int64_t i = 0; i < n; ++i) {
+        if (parents[i] != -1) {
+            weights[parents[i]] += weights[i];
+        }
+    }
+
+    std::int64_t enc_width = 0;
+
+    for (const auto& cs : color_sets) {
+        for (const auto x : cs) {
+            const std::int64_t bits = bits_required(x);
+            enc_width = std::max(enc_width, bits);
+        }
+    }
+
+    std::cout << "Exploring space/time trade-offs\n";
+    const auto spaces = compute_candidate_spaces(color_sets, parents, enc_width);
+
+    std::vector<frontier_point> points;
+    std::vector<std::int64_t> anchors;
+
+    const auto explore = [&](const double lambda) {
+        points.push_back(cost_limit(color_sets, spaces, freqs, weights, enc_width, lambda, anchors));
+        return points.back();
+    };
+
+    // lambda is the decode cost per query traded for one bit of space, so
+    // it is scaled by the mean query frequency
+    double mean_freq = 0.0;
+    for (const auto f : freqs) {
+        mean_freq += f;
+    }
+    mean_freq = n ? mean_freq / n : 1.0;
+
+    explore(0.0);
+    for (int k = -12; k <= 12; k += 2) {
+        explore(std::ldexp(mean_freq, k));
+    }
+    explore(std::numeric_limits<double>::infinity());
+
+    // refines between the smallest lambda within the budget, which has the
+    // lowest cost, and the largest explored lambda exceeding the budget, or
+    // returns infinity if no lambda meets it
+    const auto search = [&](const double budget) {
+        double feasible = std::numeric_limits<double>::infinity();
+        double infeasible = 0.0;
+        bool met = false;
+        for (const auto& p : points) {
+            if (p.space_bits <= budget && p.lambda <= feasible) {
+                feasible = p.lambda;
+                met = true;
+            }
+        }
+        for (const auto& p : points) {
+            if (p.lambda < feasible) {
+                infeasible = std::max(infeasible, p.lambda);
+            }
+        }
+
+        if (met && feasible > 0.0 && !std::isinf(feasible)) {
+            for (int it = 0; it < 10; ++it) {
+                const double mid = (infeasible == 0.0) ? feasible / 2 : std::sqrt(feasible * infeasible);
+                if (explore(mid).space_bits <= budget) {
+                    feasible = mid;
+                } else {
+                    infeasible = mid;
+                }
+            }
+        }
+
+        return feasible;
+    };
+
+    double model_budget = space_budget;
+    double feasible = search(model_budget);
+    if (std::isinf(feasible)) {
+        std::cout << "space budget cannot be met, using the smallest representation\n";
+    }
+
+    std::vector<frontier_point> frontier(points);
+    std::sort(frontier.begin(), frontier.end(), [](const frontier_point& a, const frontier_point& b) {
+        return std::tie(a.space_bits, a.expected_cost) < std::tie(b.space_bits, b.expected_cost);
+    });
+
+    std::cout << "Pareto frontier (space in bytes, expected elements decoded per query):\n";
+    std::cout << std::setw(14) << "lambda" << std::setw(16) << "space" << std::setw(16) << "cost" << "\n";
+    double best_cost = std::numeric_limits<double>::max();
+    for (const auto& p : frontier) {
+        if (p.expected_cost < best_cost) {
+            best_cost = p.expected_cost;
+            std::cout << std::setw(14) << p.lambda << std::setw(16) << static_cast<std::int64_t>(p.space_bits / 8)
+                      << std::setw(16) << p.expected_cost << "\n";
+        }
+    }
+
+    // The model does not round the vectors to words and may differ from
+    // build_ds by a few bits per set, so a build over the budget tightens
+    // lambda against a budget shrunk by the excess.
+    hcs d;
+    std::int64_t bytes = 0;
+    for (int attempt = 1;; ++attempt) {
+        const auto chosen = cost_limit(color_sets, spaces, freqs, weights, enc_width, feasible, anchors);
+
+        std::cout << "lambda: " << chosen.lambda << "\n";
+        std::cout << "modelled space in bytes: " << static_cast<std::int64_t>(chosen.space_bits / 8) << "\n";
+        std::cout << "expected elements decoded per query: " << chosen.expected_cost << "\n";
+        std::cout << "encoding width: " << enc_width << "\n";
+
+        auto [built, m] = build_ds(color_sets, anchors, enc_width);
+        d = std::move(built);
+        d.id_map = build_id_map(m, order);
+        bytes = serialized_bytes(d);
+
+        if (bytes * 8 <= space_budget || std::isinf(feasible) || attempt == max_attempts) {
+            break;
+        }
+
+        std::cout << "built " << bytes << " bytes, tightening lambda\n";
+        model_budget *= space_budget / (bytes * 8);
+        feasible = search(model_budget);
+    }
+
+    if (bytes * 8 > space_budget) {
+        std::cout << "warning: " << bytes << " bytes exceed the space budget\n";
+    }
+
+    std::cout << "d.dense_container.size() "  << d.dense_container.size()  << "\n";
+    std::cout << "d.dense_starts.size() "     << d.dense_starts.size()     << "\n";
+    std::cout << "d.sparse_container.size() " << d.sparse_container.size() << "\n";
+    std::cout << "d.sparse_starts.size() "    << d.sparse_starts.size()    << "\n";
+    std::cout << "d.coded_container.size() "  << d.coded_container.size()  << "\n";
+    std::cout << "d.coded_starts.size() "     << d.coded_starts.size()     << "\n";
+    std::cout << "d.coded_subsets.size() "    << d.coded_subsets.size()    << "\n";
+    std::cout << "d.subset_container.size() " << d.subset_container.size() << "\n";
+    std::cout << "d.subset_starts.size() "    << d.subset_starts.size()    << "\n";
+    std::cout << "d.parent_vec.size() "    << d.parent_vec.size()    << "\n";
+    std::cout << "d.id_map.size() "        << d.id_map.size()        << "\n";
+    std::cout << "\n";
+    std::cout << "size in bytes: " << d.size_in_bytes() << "\n";
+
+    std::ofstream ofs(argv[4]);
+    const auto bw = d.serialize(ofs);
+    std::cout << "bytes written: " << bw << "\n";
+    ofs.close();
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdint>
+
+// Bounded cache of decoded sets keyed by hcs id, shared by concurrent
+// queries. A cached set is stored as the bit vector that extraction builds
+// on the way to its descendants, so a query can start from the deepest
+// cached ancestor on its chain instead of from the root. The cache is split
+// into shards with a lock and an equal part of the memory cap each, and
+// every shard evicts with the CLOCK policy.
+class decode_cache {
+public:
+    explicit decode_cache(const std::size_t capacity_bytes, const std::size_t shard_count = 16)
+        : shard_count(std::max<std::size_t>(shard_count, 1)),
+          shard_capacity(capacity_bytes / this->shard_count),
+          shards(std::make_unique<shard[]>(this->shard_count)) {}
+
+    // Copies the bit vector of set id into bv and its number of bits into
+    // sz if the set is cached.
+    bool lookup(const std::int64_t id, std::vector<std::uint64_t>& bv, std::size_t& sz) {
+        auto& sh = shard_of(id);
+        std::lock_guard<std::mutex> lock(sh.mutex);
+
+        const auto it = sh.slots.find(id);
+        if (it == sh.slots.end()) {
+            return false;
+        }
+
+        auto& e = sh.entries[it->second];
+        e.referenced = true;
+        bv.assign(e.bits.begin(), e.bits.end());
+        sz = e.sz;
+
+        return true;
+    }
+
+    void insert(const std::int64_t id, const std::vector<std::uint64_t>& bv, const std::size_t sz) {
+        const std::size_t bytes = bv.size() * sizeof(std::uint64_t);
+        if (bytes > shard_capacity) {
+            return;
+        }
+
+        auto& sh = shard_of(id);
+        std::lock_guard<std::mutex> lock(sh.mutex);
+
+        if (sh.slots.count(id)) {
+            return;
+        }
+
+        while (sh.bytes + bytes > shard_capacity) {
+            evict(sh);
+        }
+
+        sh.slots[id] = sh.entries.size();
+        sh.entries.push_back({id, sz, bv, false});
+        sh.bytes += bytes;
+    }
+
+    // Counts an extraction that started from a cached set or not.
+    void record(const bool hit) {
+        (hit ? hit_count : miss_count).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t hits() const {
+        return hit_count.load(std::memory_order_relaxed);
+    }
+
+    std::uint64_t misses() const {
+        return miss_count.load(std::memory_order_relaxed);
+    }
+
+    // bytes of cached bit vectors
+    std::size_t memory_usage() const {
+        std::size_t bytes = 0;
+        for (std::size_t s = 0; s < shard_count; ++s) {
+            std::lock_guard<std::mutex> lock(shards[s].mutex);
+            bytes += shards[s].bytes;
+        }
+
+        return bytes;
+    }
+
+    void clear() {
+        for (std::size_t s = 0; s < shard_count; ++s) {
+            std::lock_guard<std::mutex> lock(shards[s].mutex);
+            shards[s].slots.clear();
+            shards[s].entries.clear();
+            shards[s].hand = 0;
+            shards[s].bytes = 0;
+        }
+        hit_count = 0;
+        miss_count = 0;
+    }
+
+private:
+    struct entry {
+        std::int64_t id;
+        std::size_t sz;
+        std::vector<std::uint64_t> bits;
+        bool referenced;
+    };
+
+    struct shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::int64_t, std::size_t> slots;
+        std::vector<entry> entries;
+        std::size_t hand = 0;
+        std::size_t bytes = 0;
+    };
+
+    shard& shard_of(const std::int64_t id) {
+        // ids of the sets of one subtree are close, so they are spread by a
+        // multiplicative hash
+        return shards[(static_cast<std::uint64_t>(id) * 0x9e3779b97f4a7c15ull >> 32) % shard_count];
+    }
+
+    // Clears the reference bits of entries under the hand until an entry
+    // without one is found and evicts it. The last entry takes its slot.
+    static void evict(shard& sh) {
+        while (true) {
+            if (sh.hand >= sh.entries.size()) {
+                sh.hand = 0;
+            }
+
+            auto& e = sh.entries[sh.hand];
+            if (e.referenced) {
+                e.referenced = false;
+                ++sh.hand;
+                continue;
+            }
+
+            sh.bytes -= e.bits.size() * sizeof(std::uint64_t);
+            sh.slots.erase(e.id);
+            if (sh.hand + 1 != sh.entries.size()) {
+                e = std::move(sh.entries.back());
+                sh.slots[e.id] = sh.hand;
+            }
+            sh.entries.pop_back();
+
+            return;
+        }
+    }
+
+    std::size_t shard_count;
+    std::size_t shard_capacity;
+    std::unique_ptr<shard[]> shards;
+    std::atomic<std::uint64_t> hit_count = 0;
+    std::atomic<std::uint64_t> miss_count = 0;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+
+#include <cstdint>
+
+#include "color_sets.hpp"
+
+// Depth limiters applied to the parents of find_parents before build_ds.
+// Both walk the chain of every set from its root and cut it whenever it
+// exceeds depth_limit: top_down_limit makes the set a subset of the root of
+// its chain, bottom_up_limit makes it a root.
+
+void top_down_limit(const color_set_collection& color_sets,
+                    std::vector<std::int64_t>& parent_vec,
+                    const std::int64_t depth_limit) {
+    std::vector<std::int64_t> depth_vec(color_sets.size(), -1);
+
+    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
+        if (depth_vec[i] == -1) {
+            std::vector<std::int64_t> st;
+            st.push_back(i);
+
+            std::int64_t parent = parent_vec[i];
+            while (parent != -1) {
+                st.push_back(parent);
+                parent = parent_vec[parent];
+            }
+
+            const std::int64_t root = st.back();
+            std::int64_t depth = 0;
+
+            while (st.size()) {
+                if (depth > depth_limit) {
+                    parent_vec[st.back()] = root;
+                    depth = 1;
+                }
+
+                const auto top = st.back(); st.pop_back();
+                depth_vec[top] = depth++;
+            }
+        }
+    }
+}
+
+void bottom_up_limit(const color_set_collection& color_sets,
+                     std::vector<std::int64_t>& parent_vec,
+                     const std::int64_t depth_limit) {
+    std::vector<std::int64_t> depth_vec(color_sets.size(), -1);
+
+    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
+        if (depth_vec[i] == -1) {
+            std::vector<std::int64_t> st;
+            st.push_back(i);
+
+            std::int64_t parent = parent_vec[i];
+            while (parent != -1) {
+                st.push_back(parent);
+                parent = parent_vec[parent];
+            }
+
+            const std::int64_t root = st.back();
+            std::int64_t depth = 0;
+
+            while (st.size()) {
+                if (depth > depth_limit) {
+                    parent_vec[st.back()] = -1;
+                    depth = 0;
+                }
+
+                const auto top = st.back(); st.pop_back();
+                depth_vec[top] = depth++;
+            }
+        }
+    }
+}
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include "color_sets.hpp"
+
+enum class parent_engine {
+    scan,           // all-pairs scan over every later set
+    inverted_index, // only later sets sharing the rarest color of the set
+    best            // cheapest of several supersets found via the index
+};
+
+struct best_parent_options {
+    // number of supersets compared per set
+    std::size_t max_supersets = 32;
+    // cost of one more level of chain depth relative to one subset bit
+    double depth_weight = 64.0;
+};
+
+static inline bool parse_parent_engine(const std::string& name, parent_engine& engine) {
+    if (name == "scan") {
+        engine = parent_engine::scan;
+    } else if (name == "index") {
+        engine = parent_engine::inverted_index;
+    } else if (name == "best") {
+        engine = parent_engine::best;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<std::int64_t> find_parents_scan(const color_set_collection& color_sets) {
+    // if ancestor[i] = -1, then set i is root set
+    std::vector<std::int64_t> ancestor_vec(color_sets.size(), -1);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
+        const auto& s1 = color_sets[i];
+
+        for (std::int64_t j = i + 1; j < color_sets.size(); ++j) {
+            const auto& s2 = color_sets[j];
+
+            // if |s1| >= |s2|, then s1 cannot be a subset of s2
+            if (s1.size() >= s2.size()) {
+                continue;
+            }
+
+            if (std::includes(s2.begin(), s2.end(), s1.begin(), s1.end())) {
+                ancestor_vec[i] = j;
+                break;
+            }
+        }
+    }
+
+    return ancestor_vec;
+}
+
+// Posting lists of set ids for every color. The ids of each list are in
+// ascending order, so the list of a color enumerates the supersets of a set
+// containing that color in the same order as the all-pairs scan.
+template<typename T>
+struct color_postings {
+    std::vector<std::size_t> starts;
+    std::vector<T> ids;
+
+    color_postings(const color_set_collection& color_sets) {
+        std::size_t colors = 0;
+        std::size_t elements = 0;
+        for (const auto& cs : color_sets) {
+            if (cs.size()) {
+                colors = std::max(colors, static_cast<std::size_t>(cs.back()) + 1);
+            }
+            elements += cs.size();
+        }
+
+        starts.assign(colors + 1, 0);
+        for (const auto& cs : color_sets) {
+            for (const auto x : cs) {
+                ++starts[x + 1];
+            }
+        }
+        for (std::size_t c = 0; c < colors; ++c) {
+            starts[c + 1] += starts[c];
+        }
+
+        ids.resize(elements);
+        std::vector<std::size_t> fill(starts.begin(), starts.end() - 1);
+        for (std::size_t i = 0; i < color_sets.size(); ++i) {
+            for (const auto x : color_sets[i]) {
+                ids[fill[x]++] = i;
+            }
+        }
+    }
+
+    std::size_t size(const std::uint32_t color) const {
+        return starts[color + 1] - starts[color];
+    }
+
+    const T* begin(const std::uint32_t color) const {
+        return ids.data() + starts[color];
+    }
+
+    const T* end(const std::uint32_t color) const {
+        return ids.data() + starts[color + 1];
+    }
+};
+
+template<typename T>
+std::vector<std::int64_t> find_parents_indexed(const color_set_collection& color_sets) {
+    // if ancestor[i] = -1, then set i is root set
+    std::vector<std::int64_t> ancestor_vec(color_sets.size(), -1);
+
+    const color_postings<T> postings(color_sets);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
+        const auto& s1 = color_sets[i];
+
+        // every later nonempty set is a superset of the empty set
+        if (s1.empty()) {
+            for (std::int64_t j = i + 1; j < color_sets.size(); ++j) {
+                if (color_sets[j].size()) {
+                    ancestor_vec[i] = j;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // a superset of s1 contains every color of s1, so it suffices to
+        // check the sets in the shortest posting list
+        std::uint32_t rarest = s1.front();
+        for (const auto x : s1) {
+            if (postings.size(x) < postings.size(rarest)) {
+                rarest = x;
+            }
+        }
+
+        const auto end = postings.end(rarest);
+        for (auto it = std::upper_bound(postings.begin(rarest), end, static_cast<T>(i)); it != end; ++it) {
+            const auto& s2 = color_sets[*it];
+
+            // if |s1| >= |s2|, then s1 cannot be a subset of s2
+            if (s1.size() >= s2.size()) {
+                continue;
+            }
+
+            if (std::includes(s2.begin(), s2.end(), s1.begin(), s1.end())) {
+                ancestor_vec[i] = *it;
+                break;
+            }
+        }
+    }
+
+    return ancestor_vec;
+}
+
+// Like find_parents_indexed, but compares up to max_supersets supersets of
+// every set and picks the one minimizing the size of the subset encoding,
+// which is the size of the parent, plus depth_weight times the depth of the
+// set in the resulting forest. Sets of equal size cannot contain each
+// other, so sizes are processed from the largest down and the depths of all
+// candidates are known when a set is processed. With depth_weight 0 the
+// first superset, i.e. the parent of the other engines, is chosen.
+template<typename T>
+std::vector<std::int64_t> find_parents_best(const color_set_collection& color_sets,
+                                            const best_parent_options& options) {
+    // if ancestor[i] = -1, then set i is root set
+    std::vector<std::int64_t> ancestor_vec(color_sets.size(), -1);
+    std::vector<std::int64_t> depth_vec(color_sets.size(), 0);
+
+    const color_postings<T> postings(color_sets);
+
+    std::int64_t end = color_sets.size();
+    while (end > 0) {
+        std::int64_t begin = end - 1;
+        while (begin > 0 && color_sets[begin - 1].size() == color_sets[end - 1].size()) {
+            --begin;
+        }
+
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (std::int64_t i = begin; i < end; ++i) {
+            const auto& s1 = color_sets[i];
+
+            std::int64_t best = -1;
+            double best_score = 0.0;
+            std::size_t supersets = 0;
+
+            const auto consider = [&](const std::int64_t j) {
+                const double score = color_sets[j].size() + options.depth_weight * depth_vec[j];
+                if (best == -1 || score < best_score) {
+                    best = j;
+                    best_score = score;
+                }
+                return ++supersets < options.max_supersets;
+            };
+
+            if (s1.empty()) {
+                for (std::int64_t j = end; j < color_sets.size(); ++j) {
+                    if (!consider(j)) {
+                        break;
+                    }
+                }
+            } else {
+                std::uint32_t rarest = s1.front();
+                for (const auto x : s1) {
+                    if (postings.size(x) < postings.size(rarest)) {
+                        rarest = x;
+                    }
+                }
+
+                // candidates are the sets after the sets of equal size
+                const auto last = postings.end(rarest);
+                for (auto it = std::lower_bound(postings.begin(rarest), last, static_cast<T>(end)); it != last; ++it) {
+                    const auto& s2 = color_sets[*it];
+
+                    if (std::includes(s2.begin(), s2.end(), s1.begin(), s1.end()) && !consider(*it)) {
+                        break;
+                    }
+                }
+            }
+
+            ancestor_vec[i] = best;
+            depth_vec[i] = (best == -1) ? 0 : depth_vec[best] + 1;
+        }
+
+        end = begin;
+    }
+
+    return ancestor_vec;
+}
+
+std::vector<std::int64_t> find_parents(const color_set_collection& color_sets,
+                                       const parent_engine engine = parent_engine::inverted_index,
+                                       const best_parent_options& options = best_parent_options()) {
+    if (engine == parent_engine::scan) {
+        return find_parents_scan(color_sets);
+    }
+
+    const bool narrow_ids = color_sets.size() <= std::numeric_limits<std::uint32_t>::max();
+
+    if (engine == parent_engine::best) {
+        return narrow_ids ? find_parents_best<std::uint32_t>(color_sets, options)
+                          : find_parents_best<std::uint64_t>(color_sets, options);
+    }
+
+    return narrow_ids ? find_parents_indexed<std::uint32_t>(color_sets)
+                      : find_parents_indexed<std::uint64_t>(color_sets);
+}
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <istream>
 #include <map>
 #include <ostream>
-#include <stack>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <cstdint>
@@ -12,27 +17,165 @@
 #include <sdsl/bit_vectors.hpp>
 #include <sdsl/bits.hpp>
 #include <sdsl/int_vector.hpp>
+#include <sdsl/io.hpp>
 
-struct hcs {
-    sdsl::bit_vector dense_container;
-    sdsl::int_vector<> dense_starts;
+#include "bit_kernels.hpp"
+#include "decode_cache.hpp"
+#include "root_codes.hpp"
+#include "subset_codes.hpp"
 
-    sdsl::int_vector<> sparse_container;
-    sdsl::int_vector<> sparse_starts;
+// Scratch buffers for extraction. Reusing one context per thread makes
+// extraction reentrant and free of heap allocations once the buffers have
+// grown to fit the largest set extracted.
+struct extract_context {
+    std::vector<std::int64_t> chain;
+    std::vector<std::uint64_t> bits;
+    std::vector<std::uint32_t> out;
+    std::vector<std::uint64_t> mask;
 
-    sdsl::bit_vector subset_container;
-    sdsl::int_vector<> subset_starts;
-    sdsl::int_vector<> parent_vec;
+    // used by intersect and union_
+    std::vector<std::int64_t> ids;
+    std::vector<std::uint8_t> dropped;
+    std::vector<std::uint64_t> acc;
+};
+
+// Scratch buffers for extract_batch.
+struct batch_context {
+    std::vector<std::int64_t> paths;
+    std::vector<std::size_t> path_starts;
+    std::vector<std::size_t> order;
+    std::vector<std::vector<std::uint64_t>> levels;
+    std::vector<std::int64_t> level_nodes;
+    std::vector<std::pair<std::size_t, std::size_t>> spans;
+    std::vector<std::uint32_t> values;
+    std::vector<std::uint32_t> out;
+    std::vector<std::uint64_t> mask;
+};
+
+// Tags of the vectors of an HCS. The required vectors are stored in this
+// order at the beginning of serialized files. Optional vectors follow, each
+// preceded by its tag, so that files without them remain loadable. The
+// mapped layout tags every vector.
+enum class hcs_section : std::uint64_t {
+    id_map = 1,
+    dense_rank,
+    subset_rank,
+    coded_container,
+    coded_starts,
+    coded_subsets,
+    skip_subsets,
+    skip_targets,
+    skip_container,
+    skip_starts,
+    subset_records,
+    delta_parents,
+    delta_kinds,
+    delta_container,
+    delta_starts,
+    delta_segments,
+    delta_ids,
+
+    dense_container = 0x100,
+    dense_starts,
+    sparse_container,
+    sparse_starts,
+    subset_container,
+    subset_starts,
+    parent_vec
+};
+
+static inline bool is_required(const hcs_section tag) {
+    return static_cast<std::uint64_t>(tag) >= static_cast<std::uint64_t>(hcs_section::dense_container);
+}
+
+// Kinds of appended sets (see hcs_append.hpp). A root is stored in the
+// smallest code of root_codes.hpp, or as an empty range if it is the empty
+// set, and a subset as the bits of a subset of its parent or in the code of
+// subset_codes.hpp.
+enum class delta_kind : std::uint8_t {
+    root,
+    subset,
+    coded_subset
+};
+
+// The storage of the vectors is a template parameter so that the same query
+// code serves both owned sdsl vectors (hcs) and read-only views into a
+// memory mapped file (hcs_view).
+template<typename BitVector, typename IntVector>
+struct basic_hcs {
+    BitVector dense_container;
+    IntVector dense_starts;
+
+    IntVector sparse_container;
+    IntVector sparse_starts;
+
+    BitVector subset_container;
+    IntVector subset_starts;
+    IntVector parent_vec;
+
+    // optional, hcs id of the set with the given id in the input of the
+    // construction pipeline
+    IntVector id_map;
+
+    // optional, number of ones before every block of rank_block bits of
+    // dense_container and subset_container, see build_rank_samples
+    IntVector dense_rank;
+    IntVector subset_rank;
+
+    static constexpr std::size_t rank_block = 512;
+
+    // optional, roots in the encodings of root_codes.hpp, which have the ids
+    // after the sparse roots
+    BitVector coded_container;
+    IntVector coded_starts;
+
+    // optional, one bit per subset, set if the range of the subset in
+    // subset_container holds the encoding of subset_codes.hpp instead of one
+    // bit per element of its parent
+    BitVector coded_subsets;
+
+    // optional, skip links: the ascending subset indices (not hcs ids) of
+    // the subsets with a link, the hcs id of the ancestor several levels up
+    // that each link points to, and the subset relative to that ancestor as
+    // one bit per element of the ancestor
+    IntVector skip_subsets;
+    IntVector skip_targets;
+    BitVector skip_container;
+    IntVector skip_starts;
+
+    // optional, one record of one or two 64-bit words per subset with its
+    // parent, the kind of its bits and either their start in
+    // subset_container or, if they fit, the bits themselves, so that a hop
+    // of a chain reads a single record, see build_subset_records
+    IntVector subset_records;
+
+    enum record_kind : std::uint8_t {
+        record_plain,
+        record_inline,
+        record_coded
+    };
 
-    hcs() {}
+    // optional, sets appended after construction (hcs_append.hpp) with the
+    // ids from base_size() on, which all queries cover: the hcs id of the
+    // parent of every appended set plus one (0 for roots), its kind, the
+    // starts of its bits in delta_container, the first appended set of
+    // every append and the hcs id of every appended input set
+    IntVector delta_parents;
+    IntVector delta_kinds;
+    BitVector delta_container;
+    IntVector delta_starts;
+    IntVector delta_segments;
+    IntVector delta_ids;
 
-    hcs(const sdsl::bit_vector& dense_container,
-       const sdsl::int_vector<>& dense_starts,
-       const sdsl::int_vector<>& sparse_container,
-       const sdsl::int_vector<>& sparse_starts,
-       const sdsl::bit_vector& subset_container,
-       const sdsl::int_vector<>& subset_starts,
-       const sdsl::int_vector<>& parent_vec)
+    basic_hcs() {}
+
+    basic_hcs(const BitVector& dense_container,
+              const IntVector& dense_starts,
+              const IntVector& sparse_container,
+              const IntVector& sparse_starts,
+              const BitVector& subset_container,
+              const IntVector& subset_starts,
+              const IntVector& parent_vec)
         : dense_container(dense_container),
           dense_starts(dense_starts),
           sparse_container(sparse_container),
@@ -41,50 +184,116 @@ struct hcs {
           subset_starts(subset_starts),
           parent_vec(parent_vec) {}
 
+    // Calls f(tag, name, vector) for every vector, required vectors first.
+    template<typename F>
+    void visit_sections(F&& f) {
+        visit_sections_of(*this, f);
+    }
+
+    template<typename F>
+    void visit_sections(F&& f) const {
+        visit_sections_of(*this, f);
+    }
+
     std::int64_t size_in_bytes() const {
-        return sdsl::size_in_bytes(dense_container)
-            + sdsl::size_in_bytes(dense_starts)
-            + sdsl::size_in_bytes(sparse_container)
-            + sdsl::size_in_bytes(sparse_starts)
-            + sdsl::size_in_bytes(subset_container)
-            + sdsl::size_in_bytes(subset_starts)
-            + sdsl::size_in_bytes(parent_vec);
+        std::int64_t bytes = 0;
+        visit_sections([&](const hcs_section, const char*, const auto& v) {
+            bytes += sdsl::size_in_bytes(v);
+        });
+
+        return bytes;
     }
 
     std::int64_t serialize(std::ostream& os) const {
         std::int64_t bytes_written = 0;
 
-        bytes_written += dense_container.serialize(os);
-        bytes_written += dense_starts.serialize(os);
-
-        bytes_written += sparse_container.serialize(os);
-        bytes_written += sparse_starts.serialize(os);
-
-        bytes_written += subset_container.serialize(os);
-        bytes_written += subset_starts.serialize(os);
-        bytes_written += parent_vec.serialize(os);
+        visit_sections([&](const hcs_section tag, const char*, const auto& v) {
+            if (is_required(tag)) {
+                bytes_written += v.serialize(os);
+            } else if (!v.empty()) {
+                bytes_written += sdsl::write_member(static_cast<std::uint64_t>(tag), os);
+                bytes_written += v.serialize(os);
+            }
+        });
 
         return bytes_written;
     }
 
     void load(std::istream& is) {
-        dense_container.load(is);
-        dense_starts.load(is);
+        visit_sections([&](const hcs_section tag, const char*, auto& v) {
+            if (is_required(tag)) {
+                v.load(is);
+            } else {
+                v = std::remove_cvref_t<decltype(v)>();
+            }
+        });
 
-        sparse_container.load(is);
-        sparse_starts.load(is);
+        while (is.peek() != std::istream::traits_type::eof()) {
+            std::uint64_t tag = 0;
+            sdsl::read_member(tag, is);
 
-        subset_container.load(is);
-        subset_starts.load(is);
-        parent_vec.load(is);
+            bool known = false;
+            visit_sections([&](const hcs_section t, const char*, auto& v) {
+                if (!is_required(t) && static_cast<std::uint64_t>(t) == tag) {
+                    v.load(is);
+                    known = true;
+                }
+            });
+
+            if (!known) {
+                throw std::runtime_error("unknown HCS section " + std::to_string(tag));
+            }
+        }
+
+        check_delta_sections();
     };
 
+    // Throws unless the delta sections describe the same appended sets.
+    void check_delta_sections() const {
+        const std::size_t n = delta_count();
+        if (delta_parents.size() != n || delta_kinds.size() != n
+            || (n && delta_container.size() < delta_starts[n])) {
+            throw std::runtime_error("inconsistent HCS delta sections");
+        }
+    }
+
+    bool has_id_map() const {
+        return !id_map.empty();
+    }
+
+    // number of input ids, those of the construction followed by those of
+    // the appended sets
+    std::int64_t input_count() const {
+        return base_input_count() + delta_ids.size();
+    }
+
+    std::int64_t base_input_count() const {
+        return has_id_map() ? id_map.size() : base_size();
+    }
+
+    // hcs id of the set with the given id in the construction input, or in
+    // the appends after it
+    std::int64_t hcs_id(const std::int64_t original_idx) const {
+        if (original_idx < 0 || original_idx >= input_count()) {
+            throw std::out_of_range("input id " + std::to_string(original_idx) + " out of range");
+        } else if (original_idx >= base_input_count()) {
+            return delta_ids[original_idx - base_input_count()];
+        }
+
+        return has_id_map() ? static_cast<std::int64_t>(id_map[original_idx]) : original_idx;
+    }
+
     bool is_root(const std::int64_t idx) const {
         return idx < root_count();
     }
 
+    // whether idx is a subset of the base, see parent_of for appended sets
     bool is_subset(const std::int64_t idx) const {
-        return !is_root(idx);
+        return !is_root(idx) && !is_delta(idx);
+    }
+
+    bool is_delta(const std::int64_t idx) const {
+        return idx >= base_size();
     }
 
     bool is_dense(const std::int64_t idx) const {
@@ -92,7 +301,65 @@ struct hcs {
     }
 
     bool is_sparse(const std::int64_t idx) const {
-        return is_root(idx) && !is_dense(idx);
+        return !is_dense(idx) && idx < dense_count() + sparse_count();
+    }
+
+    bool is_coded(const std::int64_t idx) const {
+        return is_root(idx) && idx >= dense_count() + sparse_count();
+    }
+
+    // number of subsets on the chain from the root to the set, 0 for roots
+    std::size_t depth(std::int64_t idx) const {
+        std::size_t d = 0;
+        while ((idx = parent_of(idx)) != -1) {
+            ++d;
+        }
+
+        return d;
+    }
+
+    // hcs id of the parent of set idx, or -1 for roots
+    std::int64_t parent_of(const std::int64_t idx) const {
+        if (is_delta(idx)) {
+            return static_cast<std::int64_t>(delta_parents[delta_idx(idx)]) - 1;
+        }
+
+        return is_subset(idx) ? subset_parent(subset_idx(idx)) : -1;
+    }
+
+    // whether subset ss (not hcs id) is stored in the encoding of
+    // subset_codes.hpp
+    bool is_coded_subset(const std::int64_t ss) const {
+        return !coded_subsets.empty() && coded_subsets[ss];
+    }
+
+    // index of the skip link of subset ss (not hcs id), or -1
+    std::int64_t skip_of(const std::int64_t ss) const {
+        std::size_t lo = 0;
+        std::size_t hi = skip_subsets.size();
+        while (lo < hi) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (static_cast<std::int64_t>(skip_subsets[mid]) < ss) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        return (lo < skip_subsets.size() && static_cast<std::int64_t>(skip_subsets[lo]) == ss) ? lo : -1;
+    }
+
+    std::int64_t skip_count() const {
+        return skip_subsets.size();
+    }
+
+    // hcs id of the parent of subset ss (not hcs id)
+    std::int64_t subset_parent(const std::int64_t ss) const {
+        if (subset_records.empty()) {
+            return parent_vec[ss];
+        }
+
+        return sdsl::bits::read_int(subset_records.data() + record_pos(ss) / 64, 0, record_parent_bits());
     }
 
     std::int64_t dense_count() const {
@@ -103,16 +370,34 @@ struct hcs {
         return sparse_starts.size() - 1;
     }
 
+    std::int64_t coded_count() const {
+        return coded_starts.empty() ? 0 : coded_starts.size() - 1;
+    }
+
     std::int64_t subset_count() const {
         return subset_starts.size() - 1;
     }
 
     std::int64_t root_count() const {
-        return dense_count() + sparse_count();
+        return dense_count() + sparse_count() + coded_count();
+    }
+
+    // number of sets of the construction
+    std::int64_t base_size() const {
+        return root_count() + subset_count();
+    }
+
+    std::int64_t delta_count() const {
+        return delta_starts.empty() ? 0 : delta_starts.size() - 1;
+    }
+
+    // number of appends
+    std::int64_t segment_count() const {
+        return delta_segments.size();
     }
 
     std::int64_t size() const {
-        return dense_count() + sparse_count() + subset_count();
+        return base_size() + delta_count();
     }
 
     std::int64_t dense_idx(const std::int64_t idx) const {
@@ -123,139 +408,841 @@ struct hcs {
         return idx - dense_count();
     }
 
+    std::int64_t coded_idx(const std::int64_t idx) const {
+        return idx - dense_count() - sparse_count();
+    }
+
     std::int64_t subset_idx(const std::int64_t idx) const {
         return idx - root_count();
     }
 
+    std::int64_t delta_idx(const std::int64_t idx) const {
+        return idx - base_size();
+    }
+
+    std::vector<std::uint32_t> extract_by_original_id(const std::int64_t original_idx) const {
+        return extract(hcs_id(original_idx));
+    }
+
+    void extract_by_original_id_into(const std::int64_t original_idx,
+                                     extract_context& ctx,
+                                     std::vector<std::uint32_t>& out) const {
+        extract_into(hcs_id(original_idx), ctx, out);
+    }
+
     std::vector<std::uint32_t> extract(const std::int64_t idx) const {
+        extract_context ctx;
+        std::vector<std::uint32_t> s;
+        extract_into(idx, ctx, s);
+        return s;
+    }
+
+    const std::vector<std::uint32_t>& extract(const std::int64_t idx, extract_context& ctx) const {
+        extract_into(idx, ctx, ctx.out);
+        return ctx.out;
+    }
+
+    void extract_into(const std::int64_t idx, extract_context& ctx, std::vector<std::uint32_t>& out) const {
         if (is_dense(idx)) {
-            return extract_dense(dense_idx(idx));
+            extract_dense_into(dense_idx(idx), out);
         } else if (is_sparse(idx)) {
-            return extract_sparse(sparse_idx(idx));
+            extract_sparse_into(sparse_idx(idx), out);
+        } else if (is_coded(idx)) {
+            extract_coded_into(coded_idx(idx), ctx, out);
+        } else if (is_delta(idx)) {
+            const auto sz = decode(idx, ctx);
+            bits_to_positions(ctx.bits, sz, out);
+        } else {
+            extract_subset_into(subset_idx(idx), ctx, out);
+        }
+    }
+
+    // Like extract_into, but starts the decoding of a subset of the base
+    // from its deepest ancestor in cache and caches the parent of the subset.
+    void extract_into(const std::int64_t idx,
+                      extract_context& ctx,
+                      std::vector<std::uint32_t>& out,
+                      decode_cache& cache) const {
+        if (!is_subset(idx)) {
+            extract_into(idx, ctx, out);
         } else {
-            return extract_subset(subset_idx(idx));
+            extract_subset_into(subset_idx(idx), ctx, out, &cache);
         }
     }
 
     std::vector<std::uint32_t> extract_dense(const std::int64_t idx) const {
+        std::vector<std::uint32_t> s;
+        extract_dense_into(idx, s);
+        return s;
+    }
+
+    std::vector<std::uint32_t> extract_sparse(const std::int64_t idx) const {
+        std::vector<std::uint32_t> s;
+        extract_sparse_into(idx, s);
+        return s;
+    }
+
+    std::vector<std::uint32_t> extract_subset(const std::int64_t idx) const {
+        extract_context ctx;
+        std::vector<std::uint32_t> s;
+        extract_subset_into(idx, ctx, s);
+        return s;
+    }
+
+    void extract_dense_into(const std::int64_t idx, std::vector<std::uint32_t>& s) const {
         const std::size_t beg = dense_starts[idx];
         const std::size_t end = dense_starts[idx + 1];
+
+        s.resize(popcount_range(dense_container.data(), beg, end));
+        emit_positions(dense_container.data(), beg, end, s.data());
+    }
+
+    void extract_sparse_into(const std::int64_t idx, std::vector<std::uint32_t>& s) const {
+        const std::size_t beg = sparse_starts[idx];
+        const std::size_t end = sparse_starts[idx + 1];
         const std::size_t sz = end - beg;
 
-        // TODO: optimize to use popcount
-        std::size_t elems = 0;
+        s.resize(sz);
         for (std::size_t i = 0; i < sz; ++i) {
-            if (dense_container[beg + i]) {
-                ++elems;
+            s[i] = sparse_container[beg + i];
+        }
+    }
+
+    void extract_coded_into(const std::int64_t idx, extract_context& ctx, std::vector<std::uint32_t>& s) const {
+        const auto sz = decode_root(dense_count() + sparse_count() + idx, ctx.bits);
+        bits_to_positions(ctx.bits, sz, s);
+    }
+
+    void extract_subset_into(const std::int64_t idx,
+                             extract_context& ctx,
+                             std::vector<std::uint32_t>& s,
+                             decode_cache* cache = nullptr) const {
+        const auto sz = decode_subset(idx, ctx, cache);
+        bits_to_positions(ctx.bits, sz, s);
+    }
+
+    // Decodes subset idx into ctx.bits and returns the number of bits. If
+    // bound is given, decoding stops with an empty vector as soon as an
+    // ancestor on the chain has no bit in common with bound, since a subset
+    // is contained in each of its ancestors. Skip links are followed where
+    // present, except from idx itself with a cache, whose parent is cached.
+    std::size_t decode_subset(const std::int64_t idx,
+                              extract_context& ctx,
+                              decode_cache* cache = nullptr,
+                              const std::vector<std::uint64_t>* bound = nullptr) const {
+        auto& bv = ctx.bits;
+        std::size_t sz = 0;
+        bool cached = false;
+
+        // subset indices of the chain, and the complement of the link index
+        // for a skip link
+        auto& st = ctx.chain;
+        st.clear();
+        std::int64_t ss = idx;
+        std::int64_t parent = 0;
+        while (true) {
+            const auto skip = (cache && ss == idx) ? -1 : skip_of(ss);
+            if (skip == -1) {
+                st.push_back(ss);
+                parent = subset_parent(ss);
+            } else {
+                st.push_back(~skip);
+                parent = skip_targets[skip];
+            }
+
+            if ((cached = cache && cache->lookup(parent, bv, sz)) || !is_subset(parent)) {
+                break;
             }
+            ss = subset_idx(parent);
+        }
+
+        if (cache) {
+            cache->record(cached);
         }
 
-        std::vector<std::uint32_t> s(elems);
-        for (std::size_t i = 0, j = 0; i < sz; ++i) {
-            if (dense_container[beg + i]) {
-                s[j++] = i;
+        if (!cached) {
+            sz = decode_root(parent, bv);
+        }
+        const auto words = bv.size();
+
+        // the parent of the set is cached unless decoding started from it
+        const bool cache_parent = cache && !(cached && st.size() == 1);
+
+        while (st.size()) {
+            if (bound && !intersects(bv, *bound)) {
+                bv.clear();
+                return 0;
             }
+
+            if (cache_parent && st.size() == 1) {
+                cache->insert(parent_vec[idx], bv, sz);
+            }
+
+            const auto entry = st.back(); st.pop_back();
+            if (entry < 0) {
+                deposit_subset(bv.data(), words, skip_container.data(), skip_starts[~entry]);
+            } else {
+                apply_subset(entry, bv.data(), words, ctx.mask);
+            }
+        }
+
+        return sz;
+    }
+
+    // Decodes set idx into ctx.bits and returns the number of bits. An
+    // appended subset is applied to its decoded parent.
+    std::size_t decode(const std::int64_t idx,
+                       extract_context& ctx,
+                       const std::vector<std::uint64_t>* bound = nullptr) const {
+        if (is_root(idx)) {
+            return decode_root(idx, ctx.bits);
+        } else if (is_delta(idx)) {
+            const auto parent = parent_of(idx);
+            if (parent == -1) {
+                return decode_root(idx, ctx.bits);
+            }
+
+            const auto sz = decode(parent, ctx, bound);
+            apply_delta(delta_idx(idx), ctx.bits.data(), ctx.bits.size(), ctx.mask);
+            return sz;
         }
 
+        return decode_subset(subset_idx(idx), ctx, nullptr, bound);
+    }
+
+    // upper bound on the number of elements of set idx, the size of the
+    // parent for a subset
+    std::size_t size_bound(const std::int64_t idx) const {
+        if (is_dense(idx)) {
+            return dense_starts[dense_idx(idx) + 1] - dense_starts[dense_idx(idx)];
+        } else if (is_sparse(idx)) {
+            return sparse_starts[sparse_idx(idx) + 1] - sparse_starts[sparse_idx(idx)];
+        } else if (is_coded(idx)) {
+            return coded_header(coded_idx(idx)).count;
+        } else if (is_delta(idx)) {
+            const auto k = delta_idx(idx);
+            if (delta_kind_of(k) == delta_kind::root) {
+                return cardinality(idx);
+            } else if (delta_kind_of(k) == delta_kind::coded_subset) {
+                return delta_subset(k).parent_size;
+            }
+
+            return delta_starts[k + 1] - delta_starts[k];
+        }
+
+        const auto ss = subset_idx(idx);
+        if (is_coded_subset(ss)) {
+            return coded_subset(ss).parent_size;
+        }
+
+        return subset_starts[ss + 1] - subset_starts[ss];
+    }
+
+    std::vector<std::uint32_t> intersect(const std::span<const std::int64_t> ids) const {
+        extract_context ctx;
+        std::vector<std::uint32_t> s;
+        intersect_into(ids, ctx, s);
         return s;
     }
 
-    std::vector<std::uint32_t> extract_sparse(const std::int64_t idx) const {
-        const std::size_t beg = sparse_starts[idx];
-        const std::size_t end = sparse_starts[idx + 1];
-        const std::size_t sz = end - beg;
+    // Intersects the sets of ids on their bit vectors. An ancestor of
+    // another id contains the set of that id and is skipped, the sets are
+    // intersected from the smallest bound up and decoding stops once the
+    // intersection is empty.
+    void intersect_into(const std::span<const std::int64_t> ids,
+                        extract_context& ctx,
+                        std::vector<std::uint32_t>& s) const {
+        s.clear();
+        if (ids.empty()) {
+            return;
+        }
 
-        std::vector<std::uint32_t> s(sz);
-        for (std::size_t i = 0; i < sz; ++i) {
-            s[i] = sparse_container[beg + i];
+        chain_reduce(ids, ctx, true);
+
+        auto& kept = ctx.ids;
+        std::sort(kept.begin(), kept.end(), [&](const std::int64_t a, const std::int64_t b) {
+            return size_bound(a) < size_bound(b);
+        });
+
+        auto& acc = ctx.acc;
+        std::size_t sz = decode(kept[0], ctx);
+        acc.swap(ctx.bits);
+
+        for (std::size_t k = 1; k < kept.size(); ++k) {
+            sz = std::min(sz, decode(kept[k], ctx, &acc));
+
+            const auto& bv = ctx.bits;
+            acc.resize(std::min(acc.size(), bv.size()));
+
+            std::uint64_t any = 0;
+            for (std::size_t w = 0; w < acc.size(); ++w) {
+                acc[w] &= bv[w];
+                any |= acc[w];
+            }
+
+            if (!any) {
+                return;
+            }
         }
 
+        bits_to_positions(acc, sz, s);
+    }
+
+    std::vector<std::uint32_t> union_(const std::span<const std::int64_t> ids) const {
+        extract_context ctx;
+        std::vector<std::uint32_t> s;
+        union_into(ids, ctx, s);
         return s;
     }
 
-    std::vector<std::uint32_t> extract_subset(const std::int64_t idx) const {
-        static std::stack<std::int64_t> st;
-        st.push(idx);
-        std::int64_t parent = parent_vec[idx];
-        while (is_subset(parent)) {
-            parent = subset_idx(parent);
-            st.push(parent);
-            parent = parent_vec[parent];
+    // Unites the sets of ids on their bit vectors. A descendant of another
+    // id is contained in the set of that id and is skipped.
+    void union_into(const std::span<const std::int64_t> ids,
+                    extract_context& ctx,
+                    std::vector<std::uint32_t>& s) const {
+        s.clear();
+        if (ids.empty()) {
+            return;
+        }
+
+        chain_reduce(ids, ctx, false);
+
+        auto& acc = ctx.acc;
+        acc.clear();
+        std::size_t sz = 0;
+
+        for (const auto idx : ctx.ids) {
+            sz = std::max(sz, decode(idx, ctx));
+
+            const auto& bv = ctx.bits;
+            if (acc.size() < bv.size()) {
+                acc.resize(bv.size(), 0);
+            }
+            for (std::size_t w = 0; w < bv.size(); ++w) {
+                acc[w] |= bv[w];
+            }
+        }
+
+        bits_to_positions(acc, sz, s);
+    }
+
+    // Builds subset_records. A record is one word if the parent, the kind
+    // and the start fit into 64 bits and two words otherwise. Plain subsets
+    // with at most as many bits as the rest of the record are stored inline.
+    void build_subset_records() {
+        const std::size_t parent_bits = record_parent_bits();
+        const std::size_t start_bits = std::max<std::size_t>(std::bit_width(subset_container.size()), 1);
+        const std::size_t words = (parent_bits + 2 + start_bits <= 64) ? 1 : 2;
+        const std::size_t payload_bits = words * 64 - parent_bits - 2;
+        const std::size_t start_width = std::min<std::size_t>(64, payload_bits);
+
+        sdsl::int_vector<> records(subset_count() * words, 0, 64);
+        std::uint64_t* data = records.data();
+        for (std::int64_t ss = 0; ss < subset_count(); ++ss) {
+            const std::size_t pos = ss * words * 64;
+            const std::size_t beg = subset_starts[ss];
+            const std::size_t len = subset_starts[ss + 1] - beg;
+
+            std::uint8_t kind = record_plain;
+            if (is_coded_subset(ss)) {
+                kind = record_coded;
+            } else if (len <= payload_bits) {
+                kind = record_inline;
+            }
+
+            sdsl::bits::write_int(data + pos / 64, parent_vec[ss], 0, parent_bits);
+            std::size_t payload = pos + parent_bits;
+            sdsl::bits::write_int(data + payload / 64, kind, payload % 64, 2);
+            payload += 2;
+
+            if (kind == record_inline) {
+                for (std::size_t b = 0; b < len; b += 64) {
+                    const std::size_t n = std::min<std::size_t>(64, len - b);
+                    const auto bits = sdsl::bits::read_int(subset_container.data() + (beg + b) / 64, (beg + b) % 64, n);
+                    sdsl::bits::write_int(data + (payload + b) / 64, bits, (payload + b) % 64, n);
+                }
+            } else {
+                sdsl::bits::write_int(data + payload / 64, beg, payload % 64, start_width);
+            }
+        }
+
+        subset_records = std::move(records);
+    }
+
+    bool has_subset_records() const {
+        return !subset_records.empty();
+    }
+
+    // Builds the rank samples of dense_container and subset_container,
+    // which make contains and cardinality independent of the size of the
+    // sets. Without them both count the bits of the ranges of the sets.
+    void build_rank_samples() {
+        dense_rank = rank_samples(dense_container);
+        subset_rank = rank_samples(subset_container);
+    }
+
+    bool has_rank_samples() const {
+        return !subset_rank.empty();
+    }
+
+    // Whether color is in set idx, with one rank per ancestor on the chain
+    // instead of decoding the root. Coded roots are scanned up to color.
+    bool contains(const std::int64_t idx, const std::uint32_t color) const {
+        return rank_of(idx, color) != -1;
+    }
+
+    // Number of elements of set idx. The bits of a subset are one per
+    // element of its parent and set for its own elements, so the size of a
+    // subset is the number of ones in its range.
+    std::size_t cardinality(const std::int64_t idx) const {
+        if (is_dense(idx)) {
+            const auto root = dense_idx(idx);
+            return count_ones(dense_container, dense_rank, dense_starts[root], dense_starts[root + 1]);
+        } else if (is_sparse(idx)) {
+            const auto root = sparse_idx(idx);
+            return sparse_starts[root + 1] - sparse_starts[root];
+        } else if (is_coded(idx)) {
+            return coded_header(coded_idx(idx)).count;
+        } else if (is_delta(idx)) {
+            const auto k = delta_idx(idx);
+            const std::size_t beg = delta_starts[k];
+            const std::size_t end = delta_starts[k + 1];
+            if (delta_kind_of(k) == delta_kind::root) {
+                return (beg == end) ? 0 : read_coded_root_header(delta_container.data(), beg).count;
+            } else if (delta_kind_of(k) == delta_kind::coded_subset) {
+                return delta_subset(k).cardinality();
+            }
+
+            return popcount_range(delta_container.data(), beg, end);
         }
 
+        const auto ss = subset_idx(idx);
+        if (is_coded_subset(ss)) {
+            return coded_subset(ss).cardinality();
+        }
+
+        return count_ones(subset_container, subset_rank, subset_starts[ss], subset_starts[ss + 1]);
+    }
+
+    // Extracts every set of ids with each ancestor shared by several of the
+    // sets decoded only once. The elements of the i-th set are written to
+    // values[offsets[i]:offsets[i + 1]].
+    void extract_batch(const std::span<const std::int64_t> ids,
+                       batch_context& ctx,
+                       std::vector<std::size_t>& offsets,
+                       std::vector<std::uint32_t>& values) const {
+        // root-to-set paths of every query, root first
+        ctx.path_starts.resize(ids.size() + 1);
+        ctx.paths.clear();
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            ctx.path_starts[i] = ctx.paths.size();
+
+            std::int64_t node = ids[i];
+            for (auto parent = parent_of(node); parent != -1; parent = parent_of(node)) {
+                ctx.paths.push_back(node);
+                node = parent;
+            }
+            ctx.paths.push_back(node);
+
+            std::reverse(ctx.paths.begin() + ctx.path_starts[i], ctx.paths.end());
+        }
+        ctx.path_starts[ids.size()] = ctx.paths.size();
+
+        const auto path_begin = [&](const std::size_t i) {
+            return ctx.paths.begin() + ctx.path_starts[i];
+        };
+        const auto path_end = [&](const std::size_t i) {
+            return ctx.paths.begin() + ctx.path_starts[i + 1];
+        };
+
+        // queries sharing an ancestor become adjacent in lexicographic order
+        // of their paths
+        ctx.order.resize(ids.size());
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            ctx.order[i] = i;
+        }
+        std::sort(ctx.order.begin(), ctx.order.end(), [&](const std::size_t a, const std::size_t b) {
+            return std::lexicographical_compare(path_begin(a), path_end(a), path_begin(b), path_end(b));
+        });
+
+        // decoded bit vectors of the current path, one per depth
+        std::size_t depth = 0;
+        std::size_t sz = 0;
+        ctx.level_nodes.clear();
+        ctx.spans.resize(ids.size());
+        ctx.values.clear();
+
+        for (const auto q : ctx.order) {
+            const auto beg = path_begin(q);
+            const std::size_t len = path_end(q) - beg;
+
+            std::size_t shared = 0;
+            while (shared < depth && shared < len && ctx.level_nodes[shared] == beg[shared]) {
+                ++shared;
+            }
+
+            if (ctx.levels.size() < len) {
+                ctx.levels.resize(len);
+            }
+            ctx.level_nodes.resize(len);
+
+            if (shared == 0) {
+                sz = decode_root(beg[0], ctx.levels[0]);
+                ctx.level_nodes[0] = beg[0];
+                shared = 1;
+            }
+
+            for (std::size_t l = shared; l < len; ++l) {
+                auto& bv = ctx.levels[l];
+                bv.assign(ctx.levels[l - 1].begin(), ctx.levels[l - 1].end());
+                if (is_delta(beg[l])) {
+                    apply_delta(delta_idx(beg[l]), bv.data(), bv.size(), ctx.mask);
+                } else {
+                    apply_subset(subset_idx(beg[l]), bv.data(), bv.size(), ctx.mask);
+                }
+                ctx.level_nodes[l] = beg[l];
+            }
+            depth = len;
+
+            const std::size_t start = ctx.values.size();
+            bits_to_positions(ctx.levels[len - 1], sz, ctx.out);
+            ctx.values.insert(ctx.values.end(), ctx.out.begin(), ctx.out.end());
+            ctx.spans[q] = {start, ctx.values.size() - start};
+        }
+
+        offsets.resize(ids.size() + 1);
+        offsets[0] = 0;
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            offsets[i + 1] = offsets[i] + ctx.spans[i].second;
+        }
+
+        values.resize(offsets[ids.size()]);
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            const auto [start, len] = ctx.spans[i];
+            std::copy_n(ctx.values.begin() + start, len, values.begin() + offsets[i]);
+        }
+    }
+
+    // Decodes a root into bv as a bit vector over the colors and returns the
+    // number of bits in the vector. Appended roots are coded, or empty.
+    std::size_t decode_root(const std::int64_t idx, std::vector<std::uint64_t>& bv) const {
         std::size_t beg = 0;
         std::size_t end = 0;
         std::size_t sz = 0;
 
-        if (is_dense(parent)) {
-            const auto root = dense_idx(parent);
+        if (is_coded(idx)) {
+            const auto h = coded_header(coded_idx(idx));
+            bv.assign((h.universe + 63) / 64, 0);
+            decode_coded_root(coded_container.data(), h, bv.data());
+            return h.universe;
+        } else if (is_delta(idx)) {
+            const auto k = delta_idx(idx);
+            if (delta_starts[k] == delta_starts[k + 1]) {
+                bv.clear();
+                return 0;
+            }
+
+            const auto h = read_coded_root_header(delta_container.data(), delta_starts[k]);
+            bv.assign((h.universe + 63) / 64, 0);
+            decode_coded_root(delta_container.data(), h, bv.data());
+            return h.universe;
+        }
+
+        if (is_dense(idx)) {
+            const auto root = dense_idx(idx);
             beg = dense_starts[root];
             end = dense_starts[root + 1];
             sz = end - beg;
         } else {
-            const auto root = sparse_idx(parent);
+            const auto root = sparse_idx(idx);
             beg = sparse_starts[root];
             end = sparse_starts[root + 1];
             sz = sparse_container[end - 1] + 1;
         }
 
-        sdsl::bit_vector bv(sz, 0);
+        const auto words = (sz + 63) / 64;
+        bv.assign(words, 0);
 
-        if (is_dense(parent)) {
-            for (std::size_t i = 0; i < (end - beg); ++i) {
-                bv[i] = dense_container[beg + i];
+        if (is_dense(idx)) {
+            for (std::size_t w = 0; w < words; ++w) {
+                const std::size_t pos = beg + w * 64;
+                bv[w] = sdsl::bits::read_int(dense_container.data() + pos / 64, pos % 64, std::min<std::size_t>(64, end - pos));
             }
         } else {
             for (std::size_t i = 0; i < (end - beg); ++i) {
-                bv[sparse_container[beg + i]] = 1;
+                const std::uint64_t x = sparse_container[beg + i];
+                bv[x / 64] |= 1ull << (x % 64);
             }
         }
 
-        while (st.size()) {
-            const auto ss = st.top(); st.pop();
-            const auto ss_beg = subset_starts[ss];
-            const auto ss_end = subset_starts[ss + 1];
-            const auto words = (bv.size() + 63) / 64;
-
-            for (std::size_t w = 0, elem = ss_beg; w < words; ++w) {
-                const std::uint64_t bits = std::popcount(bv.data()[w]);
-                std::uint64_t mask = ~0ull;
-                std::uint64_t temp = 0ull;
-                for (std::uint64_t b = 1; (b <= bits); ++b) {
-                    const std::uint64_t bit_idx = std::countr_zero(bv.data()[w] & mask);
-                    const std::uint64_t bit = subset_container[elem++];
-                    temp |= (bit << bit_idx);
-                    mask &= ~(1ull << bit_idx);
+        return sz;
+    }
+
+    // Position of color among the elements of set idx in ascending order,
+    // or -1 if it is not an element. The position in a subset is found
+    // from the position in its parent, which is the bit of the subset.
+    std::int64_t rank_of(const std::int64_t idx, const std::uint32_t color) const {
+        if (is_dense(idx)) {
+            const auto root = dense_idx(idx);
+            const std::size_t beg = dense_starts[root];
+            const std::size_t end = dense_starts[root + 1];
+            if (color >= end - beg || !dense_container[beg + color]) {
+                return -1;
+            }
+
+            return count_ones(dense_container, dense_rank, beg, beg + color);
+        } else if (is_sparse(idx)) {
+            const auto root = sparse_idx(idx);
+            std::size_t lo = sparse_starts[root];
+            std::size_t hi = sparse_starts[root + 1];
+            const std::size_t beg = lo;
+            while (lo < hi) {
+                const std::size_t mid = lo + (hi - lo) / 2;
+                if (sparse_container[mid] < color) {
+                    lo = mid + 1;
+                } else {
+                    hi = mid;
                 }
-                bv.data()[w] = temp;
             }
+            if (lo == sparse_starts[root + 1] || sparse_container[lo] != color) {
+                return -1;
+            }
+
+            return lo - beg;
+        } else if (is_coded(idx)) {
+            return coded_root_rank(coded_container.data(), coded_header(coded_idx(idx)), color);
+        } else if (is_delta(idx)) {
+            const auto k = delta_idx(idx);
+            const std::size_t beg = delta_starts[k];
+            if (delta_kind_of(k) == delta_kind::root) {
+                return (beg == delta_starts[k + 1]) ? -1 : coded_root_rank(delta_container.data(), read_coded_root_header(delta_container.data(), beg), color);
+            }
+
+            const auto parent_rank = rank_of(parent_of(idx), color);
+            if (parent_rank != -1 && delta_kind_of(k) == delta_kind::coded_subset) {
+                return coded_subset_rank(delta_container.data(), delta_subset(k), parent_rank);
+            } else if (parent_rank == -1 || !delta_container[beg + parent_rank]) {
+                return -1;
+            }
+
+            return popcount_range(delta_container.data(), beg, beg + parent_rank);
         }
 
-        const auto words = (bv.size() + 63) / 64;
-        std::size_t elems = 0;
-        for (std::size_t w = 0; w < words; ++w) {
-            elems += std::popcount(bv.data()[w]);
+        const auto ss = subset_idx(idx);
+        const auto parent_rank = rank_of(parent_vec[ss], color);
+        if (parent_rank != -1 && is_coded_subset(ss)) {
+            return coded_subset_rank(subset_container.data(), coded_subset(ss), parent_rank);
         }
 
-        std::vector<std::uint32_t> s(elems);
-        for (std::size_t i = 0, j = 0; i < bv.size(); ++i) {
-            if (bv[i]) {
-                s[j++] = i;
+        const std::size_t beg = subset_starts[ss];
+        if (parent_rank == -1 || !subset_container[beg + parent_rank]) {
+            return -1;
+        }
+
+        return count_ones(subset_container, subset_rank, beg, beg + parent_rank);
+    }
+
+    coded_root_header coded_header(const std::int64_t idx) const {
+        return read_coded_root_header(coded_container.data(), coded_starts[idx]);
+    }
+
+    std::size_t record_parent_bits() const {
+        return std::max<std::size_t>(std::bit_width(static_cast<std::uint64_t>(base_size())), 1);
+    }
+
+    std::size_t record_words() const {
+        return (static_cast<std::int64_t>(subset_records.size()) > subset_count()) ? 2 : 1;
+    }
+
+    std::size_t record_payload_bits() const {
+        return record_words() * 64 - record_parent_bits() - 2;
+    }
+
+    std::size_t record_pos(const std::int64_t ss) const {
+        return ss * record_words() * 64;
+    }
+
+    coded_subset_header coded_subset(const std::int64_t ss) const {
+        return read_coded_subset_header(subset_container.data(), subset_starts[ss], subset_starts[ss + 1]);
+    }
+
+    delta_kind delta_kind_of(const std::int64_t k) const {
+        return static_cast<delta_kind>(delta_kinds[k]);
+    }
+
+    coded_subset_header delta_subset(const std::int64_t k) const {
+        return read_coded_subset_header(delta_container.data(), delta_starts[k], delta_starts[k + 1]);
+    }
+
+    // Keeps the bits of the decoded parent of appended subset k (not hcs
+    // id) in bv that belong to the subset, like apply_subset.
+    void apply_delta(const std::int64_t k,
+                     std::uint64_t* bv,
+                     const std::size_t words,
+                     std::vector<std::uint64_t>& mask) const {
+        if (delta_kind_of(k) == delta_kind::coded_subset) {
+            expand_coded_subset(delta_container.data(), delta_subset(k), mask);
+            deposit_subset(bv, words, mask.data(), 0);
+        } else {
+            deposit_subset(bv, words, delta_container.data(), delta_starts[k]);
+        }
+    }
+
+    // Keeps the bits of the decoded parent of subset ss in bv that belong to
+    // the subset. A coded subset is expanded into mask first.
+    void apply_subset(const std::int64_t ss,
+                      std::uint64_t* bv,
+                      const std::size_t words,
+                      std::vector<std::uint64_t>& mask) const {
+        if (!subset_records.empty()) {
+            const std::size_t pos = record_pos(ss) + record_parent_bits();
+            const auto kind = sdsl::bits::read_int(subset_records.data() + pos / 64, pos % 64, 2);
+            if (kind == record_inline) {
+                deposit_subset(bv, words, subset_records.data(), pos + 2);
+                return;
+            } else if (kind == record_plain) {
+                const std::size_t start_pos = pos + 2;
+                const auto start = sdsl::bits::read_int(subset_records.data() + start_pos / 64, start_pos % 64,
+                                                        std::min<std::size_t>(64, record_payload_bits()));
+                deposit_subset(bv, words, subset_container.data(), start);
+                return;
             }
         }
 
-        return s;
+        if (is_coded_subset(ss)) {
+            expand_coded_subset(subset_container.data(), coded_subset(ss), mask);
+            deposit_subset(bv, words, mask.data(), 0);
+        } else {
+            deposit_subset(bv, words, subset_container.data(), subset_starts[ss]);
+        }
     }
 
-    std::map<std::string, std::int64_t> space_breakdown() const {
-       return std::map<std::string, std::int64_t>{
-            {"dense_container", sdsl::size_in_bytes(dense_container)},
-            {"dense_starts", sdsl::size_in_bytes(dense_starts)},
-            {"sparse_container", sdsl::size_in_bytes(sparse_container)},
-            {"sparse_starts", sdsl::size_in_bytes(sparse_starts)},
-            {"subset_container", sdsl::size_in_bytes(subset_container)},
-            {"subset_starts", sdsl::size_in_bytes(subset_starts)},
-            {"parent_vec", sdsl::size_in_bytes(parent_vec)}
+    // Number of ones in bits [beg, end) of bv with rank samples, which may be
+    // empty.
+    template<typename Bits, typename Samples>
+    static std::size_t count_ones(const Bits& bv, const Samples& samples, const std::size_t beg, const std::size_t end) {
+        if (samples.empty()) {
+            return popcount_range(bv.data(), beg, end);
+        }
+
+        const auto prefix = [&](const std::size_t i) {
+            const std::size_t block = i / rank_block;
+            return samples[block] + popcount_range(bv.data(), block * rank_block, i);
         };
+
+        return prefix(end) - prefix(beg);
+    }
+
+    template<typename Bits>
+    static sdsl::int_vector<> rank_samples(const Bits& bv) {
+        const std::size_t blocks = bv.size() / rank_block + 1;
+        const std::size_t ones = popcount_range(bv.data(), 0, bv.size());
+
+        sdsl::int_vector<> samples(blocks, 0, std::max<std::size_t>(std::bit_width(ones), 1));
+        std::size_t count = 0;
+        for (std::size_t b = 0; b < blocks; ++b) {
+            samples[b] = count;
+            count += popcount_range(bv.data(), b * rank_block, std::min(bv.size(), (b + 1) * rank_block));
+        }
+
+        return samples;
+    }
+
+    // Writes the distinct ids to ctx.ids without those having another of
+    // the ids as descendant (keep_descendants true) or as ancestor
+    // (keep_descendants false).
+    void chain_reduce(const std::span<const std::int64_t> ids,
+                      extract_context& ctx,
+                      const bool keep_descendants) const {
+        auto& kept = ctx.ids;
+        kept.assign(ids.begin(), ids.end());
+        std::sort(kept.begin(), kept.end());
+        kept.erase(std::unique(kept.begin(), kept.end()), kept.end());
+
+        auto& dropped = ctx.dropped;
+        dropped.assign(kept.size(), 0);
+
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            std::int64_t node = kept[i];
+            while ((node = parent_of(node)) != -1) {
+
+                const auto it = std::lower_bound(kept.begin(), kept.end(), node);
+                if (it == kept.end() || *it != node) {
+                    continue;
+                }
+
+                if (keep_descendants) {
+                    dropped[it - kept.begin()] = 1;
+                } else {
+                    dropped[i] = 1;
+                    break;
+                }
+            }
+        }
+
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < kept.size(); ++i) {
+            if (!dropped[i]) {
+                kept[n++] = kept[i];
+            }
+        }
+        kept.resize(n);
+    }
+
+    static bool intersects(const std::vector<std::uint64_t>& a, const std::vector<std::uint64_t>& b) {
+        const std::size_t words = std::min(a.size(), b.size());
+        for (std::size_t w = 0; w < words; ++w) {
+            if (a[w] & b[w]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static void bits_to_positions(const std::vector<std::uint64_t>& bv, const std::size_t sz, std::vector<std::uint32_t>& s) {
+        s.resize(popcount_range(bv.data(), 0, sz));
+        emit_positions(bv.data(), 0, sz, s.data());
+    }
+
+    std::map<std::string, std::int64_t> space_breakdown() const {
+        std::map<std::string, std::int64_t> breakdown;
+        visit_sections([&](const hcs_section, const char* name, const auto& v) {
+            breakdown[name] = sdsl::size_in_bytes(v);
+        });
+
+        return breakdown;
+    }
+
+private:
+    template<typename Self, typename F>
+    static void visit_sections_of(Self& self, F& f) {
+        f(hcs_section::dense_container, "dense_container", self.dense_container);
+        f(hcs_section::dense_starts, "dense_starts", self.dense_starts);
+        f(hcs_section::sparse_container, "sparse_container", self.sparse_container);
+        f(hcs_section::sparse_starts, "sparse_starts", self.sparse_starts);
+        f(hcs_section::subset_container, "subset_container", self.subset_container);
+        f(hcs_section::subset_starts, "subset_starts", self.subset_starts);
+        f(hcs_section::parent_vec, "parent_vec", self.parent_vec);
+
+        f(hcs_section::id_map, "id_map", self.id_map);
+        f(hcs_section::dense_rank, "dense_rank", self.dense_rank);
+        f(hcs_section::subset_rank, "subset_rank", self.subset_rank);
+        f(hcs_section::coded_container, "coded_container", self.coded_container);
+        f(hcs_section::coded_starts, "coded_starts", self.coded_starts);
+        f(hcs_section::coded_subsets, "coded_subsets", self.coded_subsets);
+        f(hcs_section::skip_subsets, "skip_subsets", self.skip_subsets);
+        f(hcs_section::skip_targets, "skip_targets", self.skip_targets);
+        f(hcs_section::skip_container, "skip_container", self.skip_container);
+        f(hcs_section::skip_starts, "skip_starts", self.skip_starts);
+        f(hcs_section::subset_records, "subset_records", self.subset_records);
+        f(hcs_section::delta_parents, "delta_parents", self.delta_parents);
+        f(hcs_section::delta_kinds, "delta_kinds", self.delta_kinds);
+        f(hcs_section::delta_container, "delta_container", self.delta_container);
+        f(hcs_section::delta_starts, "delta_starts", self.delta_starts);
+        f(hcs_section::delta_segments, "delta_segments", self.delta_segments);
+        f(hcs_section::delta_ids, "delta_ids", self.delta_ids);
     }
 };
+
+using hcs = basic_hcs<sdsl::bit_vector, sdsl::int_vector<>>;
@@ -0,0 +1,55 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "hcs_append.hpp"
+
+int main(int argc, char* argv[]) {
+    append_options options;
+    build_options compact_options;
+    bool compact = false;
+    double compact_at = 1.0;
+
+    bool valid = argc >= 4;
+    for (int i = 4; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--depth-limit" && i + 1 < argc) {
+            options.depth_limit = std::stoll(argv[++i]);
+        } else if (arg == "--compact") {
+            compact = true;
+        } else if (arg == "--compact-at" && i + 1 < argc) {
+            compact_at = std::stod(argv[++i]);
+        } else if (arg == "--layout" && i + 1 < argc) {
+            valid = parse_id_layout(argv[++i], compact_options.layout);
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        std::fprintf(stderr, "usage: %s [HCS file] [color sets file] [output file] [--depth-limit N] [--compact] [--compact-at fraction] [--layout input|dfs|bfs]\n", argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::ifstream ifs(argv[1], std::ios::binary);
+    appendable_hcs a;
+    a.d.load(ifs);
+    ifs.close();
+
+    const color_set_collection color_sets(argv[2]);
+    a.append(color_sets, options);
+
+    const double fraction = static_cast<double>(a.d.delta_count()) / a.d.size();
+    std::cout << "delta segments: " << a.d.segment_count() << "\n";
+    std::cout << "delta fraction: " << fraction << "\n";
+
+    if (compact || fraction >= compact_at) {
+        std::cout << "Compacting\n";
+        a.compact(compact_options);
+    }
+
+    std::ofstream ofs(argv[3], std::ios::binary);
+    const auto bw = a.d.serialize(ofs);
+    std::cout << "bytes written: " << bw << "\n";
+    ofs.close();
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include <cstdint>
+
+#include <sdsl/bits.hpp>
+#include <sdsl/int_vector.hpp>
+
+#include "color_sets.hpp"
+#include "hcs.hpp"
+#include "hcs_construction.hpp"
+#include "root_codes.hpp"
+#include "subset_codes.hpp"
+
+struct append_options {
+    // appended sets whose parent would be deeper than this become roots
+    std::int64_t depth_limit = std::numeric_limits<std::int64_t>::max();
+
+    // also encode subsets with the code of subset_codes.hpp when smaller
+    bool coded_subsets = true;
+};
+
+// Sink of bit_stream_writer writing at offset into a vector of words that
+// grows as needed.
+struct word_vector_writer {
+    std::vector<std::uint64_t>& words;
+    std::size_t offset;
+
+    void set_int(const std::size_t i, const std::uint64_t x, const std::uint8_t width) {
+        const std::size_t pos = offset + i;
+        // one extra word for writes crossing the end of the last word
+        if (words.size() < (pos + width) / 64 + 2) {
+            words.resize((pos + width) / 64 + 2, 0);
+        }
+        sdsl::bits::write_int(words.data() + pos / 64, x, pos % 64, width);
+    }
+};
+
+// An hcs to which color sets are appended without rebuilding it. Every
+// append is a delta segment of the delta sections of the hcs: each new set
+// gets the next id after the existing ones and becomes a subset of the
+// smallest existing superset, found like find_parents does, or a root.
+// The queries of hcs cover the base and the delta segments with the same
+// ids, and compact merges the segments into a new base with build_ds.
+class appendable_hcs {
+public:
+    hcs d;
+
+    appendable_hcs() {}
+
+    explicit appendable_hcs(hcs&& d) : d(std::move(d)) {}
+
+    // Appends the sets as one delta segment and returns the hcs id of every
+    // set. A set equal to an existing set gets the id of that set. Larger
+    // sets are appended first, so that smaller ones can be their subsets.
+    std::vector<std::int64_t> append(const color_set_collection& sets, const append_options& options = append_options()) {
+        index_sets();
+        auto postings = index_colors(sets);
+
+        const std::int64_t first_id = d.size();
+        const std::size_t ptr_width = bits_required(first_id + sets.size());
+
+        std::vector<std::int64_t> order(sets.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](const std::int64_t a, const std::int64_t b) {
+            return sets[a].size() > sets[b].size();
+        });
+
+        std::vector<std::int64_t> ids(sets.size(), -1);
+        std::vector<std::int64_t> appended;  // input index of every new set
+
+        // elements of a set, read from the input for the sets of this append
+        extract_context ctx;
+        const auto elements = [&](const std::int64_t idx) -> std::span<const std::uint32_t> {
+            if (idx >= first_id) {
+                return sets[appended[idx - first_id]];
+            }
+            d.extract_into(idx, ctx, ctx.out);
+            return ctx.out;
+        };
+
+        std::vector<std::uint64_t> parents;
+        std::vector<std::uint64_t> kinds;
+        std::vector<std::uint64_t> starts{0};
+        std::vector<std::uint64_t> words;
+        std::size_t bits = 0;
+
+        std::size_t duplicates = 0;
+        std::size_t subsets = 0;
+        std::vector<std::int64_t> candidates;
+
+        for (const auto i : order) {
+            const auto cs = sets[i];
+            std::int64_t parent = -1;
+            std::int64_t duplicate = -1;
+
+            if (cs.size()) {
+                // supersets contain the rarest color of the set, and so do
+                // equal sets
+                std::uint32_t rarest = cs.front();
+                for (const auto x : cs) {
+                    if (postings[x].size() < postings[rarest].size()) {
+                        rarest = x;
+                    }
+                }
+
+                candidates.clear();
+                for (const auto c : postings[rarest]) {
+                    if (cardinalities[c] == cs.size() ||
+                        (cardinalities[c] > cs.size() && depths[c] < options.depth_limit)) {
+                        candidates.push_back(c);
+                    }
+                }
+                std::stable_sort(candidates.begin(), candidates.end(), [&](const std::int64_t a, const std::int64_t b) {
+                    return cardinalities[a] < cardinalities[b];
+                });
+
+                for (const auto c : candidates) {
+                    const auto other = elements(c);
+                    if (other.size() == cs.size()) {
+                        if (std::equal(other.begin(), other.end(), cs.begin())) {
+                            duplicate = c;
+                            break;
+                        }
+                    } else if (std::includes(other.begin(), other.end(), cs.begin(), cs.end())) {
+                        parent = c;
+                        break;
+                    }
+                }
+            } else {
+                // the empty set is stored as an empty root
+                const auto it = std::find(cardinalities.begin(), cardinalities.end(), 0);
+                if (it != cardinalities.end()) {
+                    duplicate = it - cardinalities.begin();
+                }
+            }
+
+            if (duplicate != -1) {
+                ids[i] = duplicate;
+                ++duplicates;
+                continue;
+            }
+
+            const std::int64_t idx = first_id + appended.size();
+            appended.push_back(i);
+            ids[i] = idx;
+
+            root_code code = root_code::elias_fano;
+            std::size_t root_size = cs.empty() ? 0 : std::numeric_limits<std::size_t>::max();
+            for (const auto c : root_codes) {
+                if (cs.size() && coded_root_bits(c, cs) < root_size) {
+                    root_size = coded_root_bits(c, cs);
+                    code = c;
+                }
+            }
+
+            word_vector_writer writer{words, bits};
+            bit_stream_writer<word_vector_writer> w(writer);
+
+            const std::size_t parent_size = (parent == -1) ? 0 : cardinalities[parent];
+            const std::size_t mask_bits = subset_bits(parent_size, cs.size(), options.coded_subsets);
+            if (parent != -1 && mask_bits + ptr_width < root_size) {
+                const auto parent_elements = elements(parent);
+                if (mask_bits < parent_size) {
+                    kinds.push_back(static_cast<std::uint64_t>(delta_kind::coded_subset));
+                    encode_subset(parent_elements, cs, w);
+                } else {
+                    kinds.push_back(static_cast<std::uint64_t>(delta_kind::subset));
+                    for (std::size_t m = 0, k = 0; m < parent_elements.size(); ++m) {
+                        if (k < cs.size() && parent_elements[m] == cs[k]) {
+                            w.set(m);
+                            ++k;
+                        }
+                    }
+                    w.skip(parent_elements.size());
+                }
+                parents.push_back(parent + 1);
+                depths.push_back(depths[parent] + 1);
+                ++subsets;
+            } else {
+                kinds.push_back(static_cast<std::uint64_t>(delta_kind::root));
+                if (cs.size()) {
+                    encode_root(code, cs, w);
+                }
+                parents.push_back(0);
+                depths.push_back(0);
+            }
+
+            bits += w.position();
+            starts.push_back(bits);
+
+            cardinalities.push_back(cs.size());
+            for (const auto x : cs) {
+                postings[x].push_back(idx);
+            }
+        }
+
+        words.resize(bits / 64 + 2, 0);
+
+        std::vector<std::uint64_t> delta_ids(d.delta_ids.begin(), d.delta_ids.end());
+        delta_ids.insert(delta_ids.end(), ids.begin(), ids.end());
+
+        append_segment(parents, kinds, starts, words, bits);
+        d.delta_ids = int_vector_of(delta_ids);
+
+        std::cout << "Appended sets: " << sets.size() << "\n";
+        std::cout << "Duplicate sets: " << duplicates << "\n";
+        std::cout << "New root sets: " << appended.size() - subsets << "\n";
+        std::cout << "New subsets: " << subsets << "\n";
+
+        return ids;
+    }
+
+    // Rebuilds the hcs with build_ds from all sets, each with its current
+    // parent, so that the delta segments become part of the containers.
+    // Input ids remain valid. Optional sections other than the id map are
+    // dropped.
+    void compact(const build_options& options = build_options()) {
+        const std::int64_t n = d.size();
+
+        // parents are larger than their children, so sets in ascending
+        // order of size precede their parents as build_ds expects
+        std::vector<std::int64_t> order(n);
+        std::iota(order.begin(), order.end(), 0);
+        std::vector<std::size_t> sizes(n);
+        for (std::int64_t idx = 0; idx < n; ++idx) {
+            sizes[idx] = d.cardinality(idx);
+        }
+        std::stable_sort(order.begin(), order.end(), [&](const std::int64_t a, const std::int64_t b) {
+            return sizes[a] < sizes[b];
+        });
+
+        std::vector<std::int64_t> position(n);
+        std::vector<std::uint32_t> words;
+        std::int64_t enc_width = 0;
+        extract_context ctx;
+        for (std::int64_t i = 0; i < n; ++i) {
+            position[order[i]] = i;
+            d.extract_into(order[i], ctx, ctx.out);
+            words.push_back(ctx.out.size());
+            words.insert(words.end(), ctx.out.begin(), ctx.out.end());
+            if (ctx.out.size()) {
+                enc_width = std::max<std::int64_t>(enc_width, bits_required(ctx.out.back()));
+            }
+        }
+
+        std::vector<std::int64_t> ancestor_vec(n, -1);
+        for (std::int64_t i = 0; i < n; ++i) {
+            const auto parent = d.parent_of(order[i]);
+            ancestor_vec[i] = (parent == -1) ? -1 : position[parent];
+        }
+
+        const std::int64_t inputs = d.input_count();
+        std::vector<std::int64_t> input_ids(inputs);
+        for (std::int64_t original_idx = 0; original_idx < inputs; ++original_idx) {
+            input_ids[original_idx] = d.hcs_id(original_idx);
+        }
+
+        const color_set_collection color_sets(std::move(words));
+        auto [compacted, set_mapping] = build_ds(color_sets, ancestor_vec, enc_width, options);
+
+        compacted.id_map = sdsl::int_vector<>(inputs, 0, bits_required(n));
+        for (std::int64_t original_idx = 0; original_idx < inputs; ++original_idx) {
+            compacted.id_map[original_idx] = set_mapping[position[input_ids[original_idx]]];
+        }
+
+        d = std::move(compacted);
+        cardinalities.clear();
+        depths.clear();
+    }
+
+private:
+    // Computes the sizes and depths of the existing sets used to find the
+    // parents of appended sets, once per compaction.
+    void index_sets() {
+        if (static_cast<std::int64_t>(cardinalities.size()) == d.size()) {
+            return;
+        }
+
+        constexpr auto unknown = std::numeric_limits<std::uint32_t>::max();
+        cardinalities.assign(d.size(), 0);
+        depths.assign(d.size(), unknown);
+
+        std::vector<std::int64_t> chain;
+        for (std::int64_t idx = 0; idx < d.size(); ++idx) {
+            cardinalities[idx] = d.cardinality(idx);
+
+            // parents may have larger ids than their subsets, so every chain
+            // is resolved from its deepest ancestor of known depth and each
+            // set is visited once
+            std::int64_t node = idx;
+            while (node != -1 && depths[node] == unknown) {
+                chain.push_back(node);
+                node = d.parent_of(node);
+            }
+
+            std::uint32_t depth = (node == -1) ? 0 : depths[node] + 1;
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                depths[*it] = depth++;
+            }
+            chain.clear();
+        }
+    }
+
+    // Posting lists of the ids of the existing sets for the colors of sets,
+    // the only ones the search for parents looks up.
+    std::vector<std::vector<std::uint32_t>> index_colors(const color_set_collection& sets) const {
+        std::uint32_t max_color = 0;
+        for (const auto cs : sets) {
+            if (cs.size()) {
+                max_color = std::max(max_color, cs.back());
+            }
+        }
+
+        std::vector<bool> wanted(max_color + 1, false);
+        for (const auto cs : sets) {
+            for (const auto x : cs) {
+                wanted[x] = true;
+            }
+        }
+
+        std::vector<std::vector<std::uint32_t>> postings(max_color + 1);
+        extract_context ctx;
+        for (std::int64_t idx = 0; idx < d.size(); ++idx) {
+            d.extract_into(idx, ctx, ctx.out);
+            for (const auto x : ctx.out) {
+                if (x > max_color) {
+                    break;
+                }
+                if (wanted[x]) {
+                    postings[x].push_back(idx);
+                }
+            }
+        }
+
+        return postings;
+    }
+
+    static sdsl::int_vector<> int_vector_of(const std::vector<std::uint64_t>& values) {
+        const std::uint64_t max = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+        sdsl::int_vector<> v(values.size(), 0, bits_required(max));
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            v[i] = values[i];
+        }
+
+        return v;
+    }
+
+    // Appends the sets of one segment to the delta sections.
+    void append_segment(const std::vector<std::uint64_t>& parents,
+                        const std::vector<std::uint64_t>& kinds,
+                        const std::vector<std::uint64_t>& starts,
+                        const std::vector<std::uint64_t>& words,
+                        const std::size_t bits) {
+        // delta_container is padded for bit_stream_reader like the
+        // containers of build_ds, so its true size is the last start
+        const std::size_t old_bits = d.delta_starts.empty() ? 0 : d.delta_starts[d.delta_starts.size() - 1];
+        const std::size_t old_count = d.delta_count();
+
+        std::vector<std::uint64_t> all_parents(d.delta_parents.begin(), d.delta_parents.end());
+        all_parents.insert(all_parents.end(), parents.begin(), parents.end());
+
+        std::vector<std::uint64_t> all_kinds(d.delta_kinds.begin(), d.delta_kinds.end());
+        all_kinds.insert(all_kinds.end(), kinds.begin(), kinds.end());
+
+        std::vector<std::uint64_t> all_starts(d.delta_starts.begin(), d.delta_starts.end());
+        if (all_starts.empty()) {
+            all_starts.push_back(0);
+        }
+        for (std::size_t k = 1; k < starts.size(); ++k) {
+            all_starts.push_back(old_bits + starts[k]);
+        }
+
+        std::vector<std::uint64_t> segments(d.delta_segments.begin(), d.delta_segments.end());
+        segments.push_back(old_count);
+
+        sdsl::bit_vector container(old_bits + bits + stream_padding_bits, 0);
+        for (std::size_t b = 0; b < old_bits; b += 64) {
+            const std::size_t len = std::min<std::size_t>(64, old_bits - b);
+            container.set_int(b, d.delta_container.get_int(b, len), len);
+        }
+        for (std::size_t b = 0; b < bits; b += 64) {
+            const std::size_t len = std::min<std::size_t>(64, bits - b);
+            container.set_int(old_bits + b, sdsl::bits::read_int(words.data() + b / 64, 0, len), len);
+        }
+
+        d.delta_parents = int_vector_of(all_parents);
+        d.delta_kinds = int_vector_of(all_kinds);
+        d.delta_starts = int_vector_of(all_starts);
+        d.delta_segments = int_vector_of(segments);
+        d.delta_container = std::move(container);
+    }
+
+    // size and depth of every set, of the base and the appended sets
+    std::vector<std::uint32_t> cardinalities;
+    std::vector<std::uint32_t> depths;
+};
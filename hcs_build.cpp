@@ -0,0 +1,156 @@
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <sys/resource.h>
+
+#include "color_sets.hpp"
+#include "depth_limits.hpp"
+#include "find_parents.hpp"
+#include "hcs_construction.hpp"
+
+// Prints the wall time of every stage and the peak resident set size of the
+// process after it.
+class stage_report {
+public:
+    stage_report() : start(std::chrono::steady_clock::now()) {}
+
+    void operator()(const char* stage) {
+        const auto now = std::chrono::steady_clock::now();
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+
+        // ru_maxrss is in KiB on Linux
+        std::cout << std::left << std::setw(14) << stage << std::right
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(10) << std::chrono::duration<double>(now - start).count() << " s"
+                  << std::setw(10) << usage.ru_maxrss / 1024 << " MiB peak\n";
+        std::cout.unsetf(std::ios::floatfield);
+        start = now;
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+template<typename T>
+static void write_ints(const char* filename, const std::vector<T>& v) {
+    std::ofstream ofs(filename, std::ios::binary);
+    ofs.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
+    ofs.close();
+}
+
+int main(int argc, char* argv[]) {
+    build_options options;
+    parent_engine engine = parent_engine::inverted_index;
+    bool bottom_up = false;
+    const char* sorted_filename = nullptr;
+    const char* order_filename = nullptr;
+    const char* parents_filename = nullptr;
+
+    bool valid = argc >= 4;
+    for (int i = 4; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--limiter" && i + 1 < argc) {
+            const std::string limiter = argv[++i];
+            bottom_up = limiter == "bottom_up";
+            valid = bottom_up || limiter == "top_down";
+        } else if (arg == "--engine" && i + 1 < argc) {
+            valid = parse_parent_engine(argv[++i], engine);
+        } else if (arg == "--skip-budget" && i + 1 < argc) {
+            options.skip_budget = std::stoull(argv[++i]);
+        } else if (arg == "--layout" && i + 1 < argc) {
+            valid = parse_id_layout(argv[++i], options.layout);
+        } else if (arg == "--no-coded-roots") {
+            options.coded_roots = false;
+        } else if (arg == "--no-coded-subsets") {
+            options.coded_subsets = false;
+        } else if (arg == "--sorted" && i + 1 < argc) {
+            sorted_filename = argv[++i];
+        } else if (arg == "--order" && i + 1 < argc) {
+            order_filename = argv[++i];
+        } else if (arg == "--parents" && i + 1 < argc) {
+            parents_filename = argv[++i];
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        std::fprintf(stderr, "usage: %s [color sets file] [depth limit] [output file] [--limiter top_down|bottom_up] [--engine index|scan|best] [--skip-budget bytes] [--layout input|dfs|bfs] [--no-coded-roots] [--no-coded-subsets] [--sorted file] [--order file] [--parents file]\n", argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+    const std::int32_t depth_limit = std::stoi(argv[2]);
+    stage_report report;
+
+    // The input is mapped once and every stage works on the same mapping.
+    // Sorting only permutes the offsets of the sets, and the files of the
+    // separate tools are written in the background while the next stage
+    // runs.
+    std::vector<std::future<void>> writes;
+
+    std::cout << "Reading color sets\n";
+    color_set_collection color_sets(argv[1], MADV_WILLNEED);
+    report("read");
+
+    std::cout << "Sorting color sets\n";
+    const auto order = order_by_size(color_sets);
+    color_sets.reorder(order);
+    if (sorted_filename) {
+        writes.push_back(std::async(std::launch::async, [&] { write_color_sets(sorted_filename, color_sets); }));
+    }
+    if (order_filename) {
+        writes.push_back(std::async(std::launch::async, [&] { write_ints(order_filename, order); }));
+    }
+    report("sort");
+
+    std::cout << "Computing parents\n";
+    auto parents = find_parents(color_sets, engine);
+    if (parents_filename) {
+        // the limiters change the parents in place
+        writes.push_back(std::async(std::launch::async, [&, found = parents] { write_ints(parents_filename, found); }));
+    }
+    report("parents");
+
+    std::cout << "Computing depths\n";
+    if (bottom_up) {
+        bottom_up_limit(color_sets, parents, depth_limit);
+    } else {
+        top_down_limit(color_sets, parents, depth_limit);
+    }
+
+    std::int64_t enc_width = 0;
+
+    for (const auto& cs : color_sets) {
+        for (const auto x : cs) {
+            const std::int64_t bits = bits_required(x);
+            enc_width = std::max(enc_width, bits);
+        }
+    }
+    report("depth limit");
+
+    std::cout << "depth limit: " << depth_limit << "\n";
+    std::cout << "encoding width: " << enc_width << "\n";
+
+    auto [d, m] = build_ds(color_sets, parents, enc_width, options);
+    d.id_map = build_id_map(m, order);
+    report("build");
+
+    std::ofstream ofs(argv[3], std::ios::binary);
+    const auto bw = d.serialize(ofs);
+    ofs.close();
+    for (auto& w : writes) {
+        w.get();
+    }
+    report("write");
+
+    std::cout << "size in bytes: " << d.size_in_bytes() << "\n";
+    std::cout << "bytes written: " << bw << "\n";
+}
@@ -1,45 +1,24 @@
 #include <algorithm>
+#include <atomic>
 #include <bit>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <string>
 #include <tuple>
 #include <vector>
 
 #include <cstdint>
 
 #include <sdsl/bit_vectors.hpp>
+#include <sdsl/bits.hpp>
 #include <sdsl/int_vector.hpp>
 
+#include "color_sets.hpp"
+#include "find_parents.hpp"
 #include "hcs.hpp"
-
-template<typename T>
-std::vector<std::vector<T>> get_color_sets(const char* input_filename) {
-    std::vector<std::vector<T>> color_sets;
-
-    std::ifstream ifs(input_filename, std::ios::binary);
-    const auto begin = ifs.tellg();
-    ifs.seekg(0, std::ios::end);
-    const auto end = ifs.tellg();
-    const std::size_t file_length = end - begin;
-    ifs.seekg(0);
-    const std::size_t text_length = file_length / sizeof(T);
-
-    std::size_t i = 0;
-    while (i < text_length) {
-        std::size_t cs_sz = 0;
-        ifs.read(reinterpret_cast<char*>(&cs_sz), sizeof(T));
-        ++i;
-        std::vector<T> cs(cs_sz, 0);
-        for (std::size_t j = 0; j < cs_sz; ++j) {
-            ifs.read(reinterpret_cast<char*>(&cs[j]), sizeof(T));
-            ++i;
-        }
-        color_sets.push_back(std::move(cs));
-    }
-    ifs.close();
-
-    return color_sets;
-}
+#include "root_codes.hpp"
+#include "subset_codes.hpp"
 
 template<typename T>
 std::vector<T> get_parents(const char* input_filename) {
@@ -65,39 +44,332 @@ std::vector<T> get_parents(const char* input_filename) {
     return parents;
 }
 
+// The order file written by sort_asc has the same format as the parents
+// file: the i-th integer is the input id of the i-th sorted set.
+template<typename T>
+std::vector<T> get_order(const char* input_filename) {
+    return get_parents<T>(input_filename);
+}
+
 static inline std::size_t bits_required(const std::size_t x) {
     return std::max(static_cast<std::size_t>(std::bit_width(x)), static_cast<std::size_t>(1));
 }
 
-std::vector<std::int64_t> find_parents(const std::vector<std::vector<std::uint32_t>>& color_sets) {
-    // if ancestor[i] = -1, then set i is root set
-    std::vector<std::int64_t> ancestor_vec(color_sets.size(), -1);
+enum class set_kind : std::uint8_t {
+    dense,
+    sparse,
+    coded,
+    subset
+};
+
+// Order in which build_ds assigns the ids and container positions of the
+// sets of each kind: the order of the input, or a depth-first or
+// breadth-first traversal of every tree of the forest, which places
+// subsets next to their parents and the chains of a tree together.
+enum class id_layout {
+    input,
+    dfs,
+    bfs
+};
+
+static inline bool parse_id_layout(const std::string& name, id_layout& layout) {
+    if (name == "input") {
+        layout = id_layout::input;
+    } else if (name == "dfs") {
+        layout = id_layout::dfs;
+    } else if (name == "bfs") {
+        layout = id_layout::bfs;
+    } else {
+        return false;
+    }
 
-    #pragma omp parallel for schedule(dynamic, 1)
-    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
-        const auto& s1 = color_sets[i];
+    return true;
+}
 
-        for (std::int64_t j = i + 1; j < color_sets.size(); ++j) {
-            const auto& s2 = color_sets[j];
+struct build_options {
+    // also encode roots with the codes of root_codes.hpp when smaller
+    bool coded_roots = true;
+
+    // also encode subsets with the code of subset_codes.hpp when smaller
+    bool coded_subsets = true;
+
+    // bytes for skip links, see build_skip_links
+    std::size_t skip_budget = 0;
+
+    id_layout layout = id_layout::input;
+};
+
+struct root_choice {
+    set_kind kind;
+    root_code code;
+    std::size_t bits;
+};
+
+// The smallest encoding of a root, the bitmap on ties with the fixed-width
+// encoding and either of them on ties with a code. The empty set is an
+// empty bitmap.
+static inline root_choice choose_root(const color_set_collection::set_type cs,
+                                      const std::int64_t enc_width,
+                                      const bool coded_roots = true) {
+    if (cs.empty()) {
+        return {set_kind::dense, root_code::elias_fano, 0};
+    }
 
-            // if |s1| >= |s2|, then s1 cannot be a subset of s2
-            if (s1.size() >= s2.size()) {
-                continue;
+    const std::size_t dense_bits = cs.back() + 1;
+    const std::size_t sparse_bits = cs.size() * enc_width;
+
+    root_choice best{set_kind::sparse, root_code::elias_fano, sparse_bits};
+    if (dense_bits < sparse_bits) {
+        best = {set_kind::dense, root_code::elias_fano, dense_bits};
+    }
+
+    if (coded_roots) {
+        for (const auto code : root_codes) {
+            const std::size_t bits = coded_root_bits(code, cs);
+            if (bits < best.bits) {
+                best = {set_kind::coded, code, bits};
             }
+        }
+    }
+
+    return best;
+}
+
+// Bits of the smallest encoding of a root.
+static inline std::size_t root_bits(const color_set_collection::set_type cs,
+                                    const std::int64_t enc_width,
+                                    const bool coded_roots = true) {
+    return choose_root(cs, enc_width, coded_roots).bits;
+}
+
+// Bits of the smaller of the plain and coded encodings of a subset with
+// size elements of a parent with parent_size elements, the plain one on ties.
+static inline std::size_t subset_bits(const std::size_t parent_size,
+                                      const std::size_t size,
+                                      const bool coded_subsets = true) {
+    if (!coded_subsets) {
+        return parent_size;
+    }
 
-            if (std::includes(s2.begin(), s2.end(), s1.begin(), s1.end())) {
-                ancestor_vec[i] = j;
-                break;
+    return std::min(parent_size, coded_subset_bits(parent_size, size));
+}
+
+// Local copy of the words overlapped by a bit range of a container, so that
+// sets can be written into disjoint ranges of one container concurrently.
+// Only the first and last word of a range can be shared with other sets;
+// they are merged with an atomic OR, which suffices as the containers are
+// zero-initialized, and the words in between are stored directly.
+struct concurrent_bit_writer {
+    std::vector<std::uint64_t> words;
+    std::size_t word_count = 0;
+    std::size_t pos = 0;
+
+    void reset(const std::size_t range_pos, const std::size_t range_len) {
+        pos = range_pos;
+        word_count = (pos % 64 + range_len + 63) / 64;
+        // one extra word for set_int crossing the end of the last word
+        words.assign(word_count + 1, 0);
+    }
+
+    void set(const std::size_t i) {
+        const std::size_t bit = pos % 64 + i;
+        words[bit / 64] |= 1ull << (bit % 64);
+    }
+
+    void set_int(const std::size_t i, const std::uint64_t x, const std::uint8_t width) {
+        const std::size_t bit = pos % 64 + i;
+        sdsl::bits::write_int(words.data() + bit / 64, x, bit % 64, width);
+    }
+
+    void flush(std::uint64_t* data) const {
+        const std::size_t first = pos / 64;
+        for (std::size_t w = 0; w < word_count; ++w) {
+            if (w == 0 || w + 1 == word_count) {
+                std::atomic_ref<std::uint64_t>(data[first + w]).fetch_or(words[w], std::memory_order_relaxed);
+            } else {
+                data[first + w] = words[w];
+            }
+        }
+    }
+};
+
+// Sets in the order of layout. Trees are visited from the root with the
+// smallest index and the children of a set in ascending order.
+std::vector<std::int64_t> layout_order(const std::vector<std::int64_t>& ancestor_vec, const id_layout layout) {
+    const std::int64_t n = ancestor_vec.size();
+    std::vector<std::int64_t> order;
+    order.reserve(n);
+
+    if (layout == id_layout::input) {
+        for (std::int64_t i = 0; i < n; ++i) {
+            order.push_back(i);
+        }
+        return order;
+    }
+
+    // children of set i in children[child_starts[i]:child_starts[i + 1]]
+    std::vector<std::int64_t> child_starts(n + 1, 0);
+    for (std::int64_t i = 0; i < n; ++i) {
+        if (ancestor_vec[i] != -1) {
+            ++child_starts[ancestor_vec[i] + 1];
+        }
+    }
+    for (std::int64_t i = 0; i < n; ++i) {
+        child_starts[i + 1] += child_starts[i];
+    }
+
+    std::vector<std::int64_t> children(child_starts[n]);
+    std::vector<std::int64_t> filled(child_starts.begin(), child_starts.end() - 1);
+    for (std::int64_t i = 0; i < n; ++i) {
+        if (ancestor_vec[i] != -1) {
+            children[filled[ancestor_vec[i]]++] = i;
+        }
+    }
+
+    std::vector<std::int64_t> stack;
+    for (std::int64_t root = 0; root < n; ++root) {
+        if (ancestor_vec[root] != -1) {
+            continue;
+        }
+
+        if (layout == id_layout::dfs) {
+            stack.push_back(root);
+            while (stack.size()) {
+                const auto v = stack.back(); stack.pop_back();
+                order.push_back(v);
+                for (auto c = child_starts[v + 1]; c > child_starts[v]; --c) {
+                    stack.push_back(children[c - 1]);
+                }
+            }
+        } else {
+            // the sets of the tree appended so far are the queue
+            std::size_t k = order.size();
+            order.push_back(root);
+            for (; k < order.size(); ++k) {
+                const auto v = order[k];
+                order.insert(order.end(), children.begin() + child_starts[v], children.begin() + child_starts[v + 1]);
             }
         }
     }
 
-    return ancestor_vec;
+    return order;
+}
+
+// Adds skip links to d within budget bytes. A subset at depth t may link to
+// its ancestor lowbit(t) levels up, so that a chain of length t is decoded
+// with popcount(t) masks when all of its subsets have links. Links are
+// chosen by the number of masks they save for the subsets below them per
+// bit. ancestor_vec and set_mapping are those of build_ds.
+void build_skip_links(hcs& d,
+                      const color_set_collection& color_sets,
+                      const std::vector<std::int64_t>& ancestor_vec,
+                      const std::vector<std::int64_t>& set_mapping,
+                      const std::size_t budget) {
+    const std::int64_t n = color_sets.size();
+    const std::size_t ptr_width = bits_required(color_sets.size());
+
+    // parents have larger indices than their children
+    std::vector<std::uint32_t> depths(n, 0);
+    for (std::int64_t i = n - 1; i >= 0; --i) {
+        if (ancestor_vec[i] != -1) {
+            depths[i] = depths[ancestor_vec[i]] + 1;
+        }
+    }
+
+    std::vector<std::uint64_t> subtree_sizes(n, 1);
+    for (std::int64_t i = 0; i < n; ++i) {
+        if (ancestor_vec[i] != -1) {
+            subtree_sizes[ancestor_vec[i]] += subtree_sizes[i];
+        }
+    }
+
+    struct candidate {
+        std::int64_t set;
+        std::int64_t target;
+        double gain;
+        std::size_t bits;
+    };
+
+    std::vector<candidate> candidates;
+    for (std::int64_t i = 0; i < n; ++i) {
+        if (depths[i] == 0) {
+            continue;
+        }
+
+        const std::uint32_t hops = std::uint32_t(1) << std::countr_zero(depths[i]);
+        if (hops < 2) {
+            continue;
+        }
+
+        std::int64_t target = i;
+        for (std::uint32_t h = 0; h < hops; ++h) {
+            target = ancestor_vec[target];
+        }
+
+        // the link, its target, its start and the mask
+        const std::size_t bits = 3 * ptr_width + color_sets[target].size();
+        candidates.push_back({i, target, static_cast<double>(hops - 1) * subtree_sizes[i], bits});
+    }
+
+    const std::size_t candidate_count = candidates.size();
+    std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+        return a.gain * b.bits > b.gain * a.bits;
+    });
+
+    std::size_t used = 0;
+    std::size_t chosen = 0;
+    for (const auto& c : candidates) {
+        if (used + c.bits <= budget * 8) {
+            used += c.bits;
+            candidates[chosen++] = c;
+        }
+    }
+    candidates.resize(chosen);
+
+    std::cout << "Skip links: " << chosen << " of " << candidate_count << " candidates\n";
+    if (!chosen) {
+        return;
+    }
+
+    const std::int64_t root_count = d.root_count();
+    std::sort(candidates.begin(), candidates.end(), [&](const candidate& a, const candidate& b) {
+        return set_mapping[a.set] < set_mapping[b.set];
+    });
+
+    std::size_t mask_bits = 0;
+    for (const auto& c : candidates) {
+        mask_bits += color_sets[c.target].size();
+    }
+
+    d.skip_subsets = sdsl::int_vector<>(chosen, 0, ptr_width);
+    d.skip_targets = sdsl::int_vector<>(chosen, 0, ptr_width);
+    d.skip_container = sdsl::bit_vector(mask_bits + stream_padding_bits, 0);
+    d.skip_starts = sdsl::int_vector<>(chosen + 1, 0, bits_required(mask_bits));
+
+    std::size_t pos = 0;
+    for (std::size_t k = 0; k < chosen; ++k) {
+        const auto cs = color_sets[candidates[k].set];
+        const auto target = color_sets[candidates[k].target];
+
+        d.skip_subsets[k] = set_mapping[candidates[k].set] - root_count;
+        d.skip_targets[k] = set_mapping[candidates[k].target];
+        for (std::size_t m = 0, j = 0; m < target.size(); ++m) {
+            if (j < cs.size() && target[m] == cs[j]) {
+                d.skip_container[pos + m] = 1;
+                ++j;
+            }
+        }
+        pos += target.size();
+        d.skip_starts[k + 1] = pos;
+    }
 }
 
-std::tuple<hcs, std::vector<int64_t>> build_ds(const std::vector<std::vector<std::uint32_t>>& color_sets,
-                                              std::vector<std::int64_t>& ancestor_vec,
-                                              const std::int64_t enc_width) {
+std::tuple<hcs, std::vector<int64_t>> build_ds(const color_set_collection& color_sets,
+                                               std::vector<std::int64_t>& ancestor_vec,
+                                               const std::int64_t enc_width,
+                                               const build_options& options = build_options()) {
+    const std::int64_t n = color_sets.size();
+
     std::size_t subset_count = 0;
     std::size_t subset_elements = 0;
 
@@ -107,56 +379,74 @@ std::tuple<hcs, std::vector<int64_t>> build_ds(const std::vector<std::vector<std
     std::size_t sparse_count = 0;
     std::size_t sparse_elements = 0;
 
-    std::size_t root_count = 0;
-    const std::size_t ptr_width = bits_required(color_sets.size());
+    std::size_t coded_count = 0;
+    std::size_t coded_elements = 0;
 
-    std::cout << "Computing space for roots\n";
+    std::size_t coded_subset_count = 0;
 
-    for (std::int64_t i = 0; i < ancestor_vec.size(); ++i) {
-        if (ancestor_vec[i] == -1) {
-            ++root_count;
+    const std::size_t ptr_width = bits_required(color_sets.size());
 
-            const std::size_t dense_bits = color_sets[i].back() + 1;
-            const std::size_t sparse_bits = color_sets[i].size() * enc_width;
+    // kind of every set and its number of elements in its container, which
+    // is replaced by the start of the set in the container below
+    std::vector<set_kind> kinds(n);
+    std::vector<root_code> codes(n);
+    std::vector<std::uint8_t> coded_masks(n, 0);
+    std::vector<std::size_t> positions(n);
 
-            if (dense_bits < sparse_bits) {
-                ++dense_count;
-                dense_elements += dense_bits;
-            } else {
-                ++sparse_count;
-                sparse_elements += color_sets[i].size();
-            }
-        } else {
-            const auto ancestor_idx = ancestor_vec[i];
-            const std::size_t ancestor_bits = color_sets[ancestor_idx].size();
-            const std::size_t ss_bits = ancestor_bits + ptr_width;
+    std::cout << "Computing space for roots\n";
 
-            const std::size_t dense_bits = color_sets[i].back() + 1;
-            const std::size_t sparse_bits = color_sets[i].size() * enc_width;
+    #pragma omp parallel for schedule(dynamic, 1024) \
+        reduction(+:subset_count, subset_elements, dense_count, dense_elements, sparse_count, sparse_elements, \
+                    coded_count, coded_elements, coded_subset_count)
+    for (std::int64_t i = 0; i < n; ++i) {
+        const auto root = choose_root(color_sets[i], enc_width, options.coded_roots);
 
-            if ((ss_bits < dense_bits) && (ss_bits < sparse_bits)) {
+        if (ancestor_vec[i] != -1) {
+            const auto ancestor_idx = ancestor_vec[i];
+            const std::size_t ancestor_size = color_sets[ancestor_idx].size();
+            const std::size_t mask_bits = subset_bits(ancestor_size, color_sets[i].size(), options.coded_subsets);
+            const std::size_t ss_bits = mask_bits + ptr_width;
+
+            if (ss_bits < root.bits) {
+                kinds[i] = set_kind::subset;
+                coded_masks[i] = mask_bits < ancestor_size;
+                positions[i] = mask_bits;
                 ++subset_count;
-                subset_elements += ancestor_bits;
-            } else {
-                ancestor_vec[i] = -1;
-                ++root_count;
-                if (dense_bits < sparse_bits) {
-                    ++dense_count;
-                    dense_elements += dense_bits;
-                } else {
-                    ++sparse_count;
-                    sparse_elements += color_sets[i].size();
-                }
+                subset_elements += mask_bits;
+                coded_subset_count += coded_masks[i];
+                continue;
             }
+
+            ancestor_vec[i] = -1;
+        }
+
+        kinds[i] = root.kind;
+        if (root.kind == set_kind::dense) {
+            positions[i] = root.bits;
+            ++dense_count;
+            dense_elements += root.bits;
+        } else if (root.kind == set_kind::sparse) {
+            positions[i] = color_sets[i].size();
+            ++sparse_count;
+            sparse_elements += color_sets[i].size();
+        } else {
+            codes[i] = root.code;
+            positions[i] = root.bits;
+            ++coded_count;
+            coded_elements += root.bits;
         }
     }
 
+    const std::size_t root_count = dense_count + sparse_count + coded_count;
+
     std::vector<std::int64_t> set_mapping(color_sets.size(), -1);
 
     std::cout << "Root sets: " << root_count << "\n";
     std::cout << "Dense root sets: " << dense_count << "\n";
     std::cout << "Sparse root sets: " << sparse_count << "\n";
+    std::cout << "Coded root sets: " << coded_count << "\n";
     std::cout << "Subsets: " << subset_count << "\n";
+    std::cout << "Coded subsets: " << coded_subset_count << "\n";
 
     sdsl::bit_vector dense_roots(dense_elements, 0);
     sdsl::int_vector<> dense_starts(dense_count + 1, 0, bits_required(dense_elements));
@@ -164,16 +454,22 @@ std::tuple<hcs, std::vector<int64_t>> build_ds(const std::vector<std::vector<std
     sdsl::int_vector<> sparse_roots(sparse_elements, 0, enc_width);
     sdsl::int_vector<> sparse_starts(sparse_count + 1, 0, bits_required(sparse_elements));
 
-    sdsl::bit_vector subsets(subset_elements, 0);
+    // padded for bit_stream_reader, the true sizes are the last starts
+    sdsl::bit_vector coded_roots(coded_elements + stream_padding_bits, 0);
+    sdsl::int_vector<> coded_starts(coded_count + 1, 0, bits_required(coded_elements));
+
+    sdsl::bit_vector subsets(subset_elements + stream_padding_bits, 0);
     sdsl::int_vector<> subset_starts(subset_count + 1, 0, bits_required(subset_elements));
     sdsl::int_vector<> ancestor_ptrs(subset_count, 0, bits_required(color_sets.size()));
+    sdsl::bit_vector coded_subsets(subset_count, 0);
 
-    std::cout << "Computing representation\n";
+    std::cout << "Computing positions\n";
 
     {
         std::int64_t dense_idx = 0;
         std::int64_t sparse_idx = dense_count;
-        std::int64_t subset_idx = dense_count + sparse_count;
+        std::int64_t coded_idx = dense_count + sparse_count;
+        std::int64_t subset_idx = root_count;
 
         std::size_t dense_container_idx = 0;
         std::size_t dense_starts_idx = 1;
@@ -181,78 +477,134 @@ std::tuple<hcs, std::vector<int64_t>> build_ds(const std::vector<std::vector<std
         std::size_t sparse_container_idx = 0;
         std::size_t sparse_starts_idx = 1;
 
+        std::size_t coded_container_idx = 0;
+        std::size_t coded_starts_idx = 1;
+        std::size_t code_counts[std::size(root_codes)] = {};
+
         std::size_t subset_container_idx = 0;
         std::size_t subset_starts_idx = 1;
 
-        for (std::int64_t i = 0; i < color_sets.size(); ++i) {
-            if (ancestor_vec[i] == -1) {
-                const std::int64_t sparse_bits = color_sets[i].size() * enc_width;
-                const std::int64_t dense_bits = color_sets[i].back() + 1;
-
-                if (dense_bits < sparse_bits) {
-                    std::vector<bool> temp_bv(color_sets[i].back() + 1, 0);
-
-                    for (const auto x : color_sets[i]) {
-                        temp_bv[x] = 1;
-                    }
+        for (const auto i : layout_order(ancestor_vec, options.layout)) {
+            const std::size_t elements = positions[i];
+
+            if (kinds[i] == set_kind::dense) {
+                positions[i] = dense_container_idx;
+                dense_container_idx += elements;
+                dense_starts[dense_starts_idx++] = dense_container_idx;
+                set_mapping[i] = dense_idx++;
+            } else if (kinds[i] == set_kind::sparse) {
+                positions[i] = sparse_container_idx;
+                sparse_container_idx += elements;
+                sparse_starts[sparse_starts_idx++] = sparse_container_idx;
+                set_mapping[i] = sparse_idx++;
+            } else if (kinds[i] == set_kind::coded) {
+                positions[i] = coded_container_idx;
+                coded_container_idx += elements;
+                coded_starts[coded_starts_idx++] = coded_container_idx;
+                set_mapping[i] = coded_idx++;
+                ++code_counts[static_cast<std::size_t>(codes[i])];
+            } else {
+                positions[i] = subset_container_idx;
+                subset_container_idx += elements;
+                subset_starts[subset_starts_idx++] = subset_container_idx;
+                coded_subsets[subset_idx - root_count] = coded_masks[i];
+                set_mapping[i] = subset_idx++;
+            }
+        }
 
-                    for (const auto x : temp_bv) {
-                        dense_roots[dense_container_idx++] = x;
-                    }
+        for (const auto code : root_codes) {
+            std::cout << "Coded root sets (" << root_code_name(code) << "): "
+                      << code_counts[static_cast<std::size_t>(code)] << "\n";
+        }
+    }
 
-                    dense_starts[dense_starts_idx++] = dense_container_idx;
+    std::cout << "Computing representation\n";
 
-                    set_mapping[i] = dense_idx++;
-                } else {
-                    for (const auto x : color_sets[i]) {
-                        sparse_roots[sparse_container_idx++] = x;
-                    }
+    #pragma omp parallel
+    {
+        concurrent_bit_writer writer;
 
-                    sparse_starts[sparse_starts_idx++] = sparse_container_idx;
+        #pragma omp for schedule(dynamic, 1024)
+        for (std::int64_t i = 0; i < n; ++i) {
+            const auto cs = color_sets[i];
 
-                    set_mapping[i] = sparse_idx++;
+            if (kinds[i] == set_kind::dense) {
+                if (cs.empty()) {
+                    continue;
+                }
+                writer.reset(positions[i], cs.back() + 1);
+                for (const auto x : cs) {
+                    writer.set(x);
                 }
+                writer.flush(dense_roots.data());
+            } else if (kinds[i] == set_kind::sparse) {
+                writer.reset(positions[i] * enc_width, cs.size() * enc_width);
+                for (std::size_t k = 0; k < cs.size(); ++k) {
+                    writer.set_int(k * enc_width, cs[k], enc_width);
+                }
+                writer.flush(sparse_roots.data());
+            } else if (kinds[i] == set_kind::coded) {
+                const std::size_t coded_id = set_mapping[i] - dense_count - sparse_count;
+                writer.reset(positions[i], coded_starts[coded_id + 1] - positions[i]);
+                bit_stream_writer<concurrent_bit_writer> w(writer);
+                encode_root(codes[i], cs, w);
+                writer.flush(coded_roots.data());
             } else {
                 const auto ancestor_idx = ancestor_vec[i];
-                const std::int64_t ancestor_size = color_sets[ancestor_idx].size();
-                std::vector<bool> temp_bv(ancestor_size, 0);
+                const auto ancestor = color_sets[ancestor_idx];
+                const std::int64_t ancestor_size = ancestor.size();
 
-                for (std::int64_t m = 0, k = 0; m < ancestor_size; ++m) {
-                    if (k < color_sets[i].size() && color_sets[ancestor_idx][m] == color_sets[i][k]) {
-                        temp_bv[m] = 1;
-                        ++k;
+                if (coded_masks[i]) {
+                    writer.reset(positions[i], coded_subset_bits(ancestor_size, cs.size()));
+                    bit_stream_writer<concurrent_bit_writer> w(writer);
+                    encode_subset(ancestor, cs, w);
+                } else {
+                    writer.reset(positions[i], ancestor_size);
+                    for (std::int64_t m = 0, k = 0; m < ancestor_size; ++m) {
+                        if (k < cs.size() && ancestor[m] == cs[k]) {
+                            writer.set(m);
+                            ++k;
+                        }
                     }
                 }
+                writer.flush(subsets.data());
 
-                for (const auto x : temp_bv) {
-                    subsets[subset_container_idx++] = x;
-                }
-
-                subset_starts[subset_starts_idx++] = subset_container_idx;
-
-                set_mapping[i] = subset_idx++;
+                const std::size_t subset_id = set_mapping[i] - root_count;
+                writer.reset(subset_id * ancestor_ptrs.width(), ancestor_ptrs.width());
+                writer.set_int(0, set_mapping[ancestor_idx], ancestor_ptrs.width());
+                writer.flush(ancestor_ptrs.data());
             }
         }
     }
 
-    std::cout << "Computing ancestor pointers\n";
+    hcs d(dense_roots, dense_starts, sparse_roots, sparse_starts, subsets, subset_starts, ancestor_ptrs);
 
-    {
-        std::int64_t subset_idx = 0;
+    // files without coded roots or subsets keep the format of plain ones
+    if (coded_count) {
+        d.coded_container = std::move(coded_roots);
+        d.coded_starts = std::move(coded_starts);
+    }
+    if (coded_subset_count) {
+        d.coded_subsets = std::move(coded_subsets);
+    }
 
-        for (std::int64_t i = 0; i < ancestor_vec.size(); ++i) {
-            const auto ancestor = ancestor_vec[i];
+    if (options.skip_budget) {
+        build_skip_links(d, color_sets, ancestor_vec, set_mapping, options.skip_budget);
+    }
 
-            if (ancestor != -1) {
-                const std::int64_t subset_id = subset_idx++;
-                const std::int64_t ancestor_id = set_mapping[ancestor];
-                ancestor_ptrs[subset_id] = ancestor_id;
+    return {std::move(d), set_mapping};
+}
 
-                const auto ss_sz = subset_starts[subset_id + 1] - subset_starts[subset_id];
-                const auto anc_sz = color_sets[ancestor].size();
-            }
-        }
+// Maps the ids of the construction input to hcs ids. The set at position i
+// of the sorted color sets has input id order[i], or i if order is empty.
+sdsl::int_vector<> build_id_map(const std::vector<std::int64_t>& set_mapping,
+                                const std::vector<std::int64_t>& order) {
+    sdsl::int_vector<> id_map(set_mapping.size(), 0, bits_required(set_mapping.size()));
+
+    for (std::size_t i = 0; i < set_mapping.size(); ++i) {
+        const std::size_t original_idx = order.empty() ? i : order[i];
+        id_map[original_idx] = set_mapping[i];
     }
 
-    return {hcs(dense_roots, dense_starts, sparse_roots, sparse_starts, subsets, subset_starts, ancestor_ptrs), set_mapping};
+    return id_map;
 }
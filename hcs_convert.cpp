@@ -0,0 +1,46 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "hcs.hpp"
+#include "hcs_view.hpp"
+
+int main(int argc, char* argv[]) {
+    bool rank_samples = false;
+    bool subset_records = false;
+
+    bool valid = argc >= 3;
+    for (int i = 3; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--rank-samples") {
+            rank_samples = true;
+        } else if (arg == "--subset-records") {
+            subset_records = true;
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        std::fprintf(stderr, "usage: %s [HCS file] [mapped HCS file] [--rank-samples] [--subset-records]\n", argv[0]);
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::ifstream ifs(argv[1], std::ios::binary);
+
+    hcs d;
+    d.load(ifs);
+    ifs.close();
+
+    if (rank_samples) {
+        d.build_rank_samples();
+    }
+    if (subset_records) {
+        d.build_subset_records();
+    }
+
+    std::ofstream ofs(argv[2], std::ios::binary);
+    const auto bw = write_mapped(d, ofs);
+    std::cout << "bytes written: " << bw << "\n";
+    ofs.close();
+}
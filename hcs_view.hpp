@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <sdsl/bits.hpp>
+#include <sdsl/io.hpp>
+
+#include "hcs.hpp"
+#include "mapped_file.hpp"
+
+// Mapped layout of an HCS file, all integers little endian:
+//
+//   header     64 bytes, magic, version and number of sections
+//   sections   one 32-byte entry (tag, offset, bit size, width) per vector
+//   data       the words of every vector starting at a 64-byte aligned
+//              offset and followed by at least one zero word, so that
+//              word-wise reads may touch the word after the last one
+//
+// hcs_view serves queries directly from a mapping of such a file.
+
+struct mapped_header {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t section_count;
+    std::uint64_t reserved[5];
+};
+
+struct mapped_section {
+    std::uint64_t tag;
+    std::uint64_t offset;
+    std::uint64_t bit_size;
+    std::uint64_t width;
+};
+
+static constexpr char mapped_magic[8] = {'H', 'C', 'S', 'M', 'A', 'P', '\0', '\0'};
+static constexpr std::uint64_t mapped_version = 1;
+static constexpr std::uint64_t mapped_alignment = 64;
+
+static_assert(sizeof(mapped_header) == 64);
+static_assert(sizeof(mapped_section) == 32);
+
+// Read-only view of the words of an int_vector stored elsewhere.
+class packed_view {
+public:
+    packed_view() {}
+
+    packed_view(const std::uint64_t* data, const std::uint64_t bit_size, const std::uint8_t width)
+        : m_data(data), m_bit_size(bit_size), m_width(width) {}
+
+    std::uint64_t size() const {
+        return m_bit_size / m_width;
+    }
+
+    std::uint64_t bit_size() const {
+        return m_bit_size;
+    }
+
+    std::uint8_t width() const {
+        return m_width;
+    }
+
+    bool empty() const {
+        return m_bit_size == 0;
+    }
+
+    const std::uint64_t* data() const {
+        return m_data;
+    }
+
+    std::uint64_t get_int(const std::uint64_t idx, const std::uint8_t len = 64) const {
+        return sdsl::bits::read_int(m_data + (idx >> 6), idx & 63, len);
+    }
+
+    std::uint64_t operator[](const std::uint64_t i) const {
+        return get_int(i * m_width, m_width);
+    }
+
+private:
+    const std::uint64_t* m_data = nullptr;
+    std::uint64_t m_bit_size = 0;
+    std::uint8_t m_width = 1;
+};
+
+static inline std::uint64_t mapped_padded_bytes(const std::uint64_t bit_size) {
+    const std::uint64_t bytes = ((bit_size + 63) / 64 + 1) * 8;
+    return (bytes + mapped_alignment - 1) / mapped_alignment * mapped_alignment;
+}
+
+// Writes d in the mapped layout and returns the number of bytes written.
+template<typename BitVector, typename IntVector>
+std::int64_t write_mapped(const basic_hcs<BitVector, IntVector>& d, std::ostream& os) {
+    std::vector<mapped_section> sections;
+    d.visit_sections([&](const hcs_section tag, const char*, const auto& v) {
+        if (is_required(tag) || !v.empty()) {
+            sections.push_back({static_cast<std::uint64_t>(tag), 0, v.bit_size(), v.width()});
+        }
+    });
+
+    std::uint64_t offset = sizeof(mapped_header) + sections.size() * sizeof(mapped_section);
+    offset = (offset + mapped_alignment - 1) / mapped_alignment * mapped_alignment;
+    for (auto& section : sections) {
+        section.offset = offset;
+        offset += mapped_padded_bytes(section.bit_size);
+    }
+
+    mapped_header header{};
+    std::memcpy(header.magic, mapped_magic, sizeof(mapped_magic));
+    header.version = mapped_version;
+    header.section_count = sections.size();
+
+    std::uint64_t bytes_written = 0;
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(sections.data()), sections.size() * sizeof(mapped_section));
+    bytes_written += sizeof(header) + sections.size() * sizeof(mapped_section);
+
+    const std::vector<char> zeros(mapped_alignment + 8, 0);
+    const auto pad_to = [&](const std::uint64_t target) {
+        while (bytes_written < target) {
+            const std::uint64_t n = std::min<std::uint64_t>(target - bytes_written, zeros.size());
+            os.write(zeros.data(), n);
+            bytes_written += n;
+        }
+    };
+
+    std::size_t i = 0;
+    d.visit_sections([&](const hcs_section tag, const char*, const auto& v) {
+        if (is_required(tag) || !v.empty()) {
+            const auto& section = sections[i++];
+            pad_to(section.offset);
+            const std::uint64_t bytes = (v.bit_size() + 63) / 64 * 8;
+            os.write(reinterpret_cast<const char*>(v.data()), bytes);
+            bytes_written += bytes;
+            pad_to(section.offset + mapped_padded_bytes(section.bit_size));
+        }
+    });
+
+    return static_cast<std::int64_t>(bytes_written);
+}
+
+// Checks whether the file starts with the magic of the mapped layout.
+static inline bool is_mapped_hcs(const char* filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    char magic[sizeof(mapped_magic)] = {};
+    ifs.read(magic, sizeof(magic));
+    return ifs && std::memcmp(magic, mapped_magic, sizeof(magic)) == 0;
+}
+
+// HCS served from a read-only shared mapping of a file in the mapped layout.
+// Opening only validates the section table, the vectors are paged in on
+// access and shared between all processes mapping the same file.
+struct hcs_view : basic_hcs<packed_view, packed_view> {
+    mapped_file file;
+
+    hcs_view() {}
+
+    explicit hcs_view(const char* filename) {
+        open(filename);
+    }
+
+    void open(const char* filename) {
+        file = mapped_file(filename);
+        *static_cast<basic_hcs<packed_view, packed_view>*>(this) = basic_hcs<packed_view, packed_view>();
+
+        const auto fail = [&](const std::string& msg) {
+            throw std::runtime_error(std::string(filename) + ": " + msg);
+        };
+
+        if (file.size() < sizeof(mapped_header)) {
+            fail("not a mapped HCS file");
+        }
+
+        mapped_header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, mapped_magic, sizeof(mapped_magic)) != 0) {
+            fail("not a mapped HCS file");
+        }
+        if (header.version != mapped_version) {
+            fail("unsupported version " + std::to_string(header.version));
+        }
+        if (header.section_count > (file.size() - sizeof(mapped_header)) / sizeof(mapped_section)) {
+            fail("truncated section table");
+        }
+
+        const auto* sections = reinterpret_cast<const mapped_section*>(file.data() + sizeof(mapped_header));
+        std::uint64_t required = 0;
+        std::set<std::uint64_t> seen;
+        for (std::uint64_t s = 0; s < header.section_count; ++s) {
+            const auto& section = sections[s];
+            // the size is bounded before padding it, which could overflow
+            if (section.offset % 8 != 0 || section.width == 0 || section.width > 64
+                || section.offset > file.size()
+                || section.bit_size > 8 * (file.size() - section.offset)
+                || mapped_padded_bytes(section.bit_size) > file.size() - section.offset) {
+                fail("corrupt section " + std::to_string(section.tag));
+            }
+            if (!seen.insert(section.tag).second) {
+                fail("duplicate section " + std::to_string(section.tag));
+            }
+
+            bool known = false;
+            visit_sections([&](const hcs_section tag, const char*, packed_view& v) {
+                if (static_cast<std::uint64_t>(tag) == section.tag) {
+                    const auto* data = reinterpret_cast<const std::uint64_t*>(file.data() + section.offset);
+                    v = packed_view(data, section.bit_size, section.width);
+                    known = true;
+                    required += is_required(tag);
+                }
+            });
+
+            if (!known) {
+                fail("unknown section " + std::to_string(section.tag));
+            }
+        }
+
+        std::uint64_t required_count = 0;
+        visit_sections([&](const hcs_section tag, const char*, const packed_view&) {
+            required_count += is_required(tag);
+        });
+        if (required != required_count) {
+            fail("missing required sections");
+        }
+
+        try {
+            check_delta_sections();
+        } catch (const std::runtime_error& e) {
+            fail(e.what());
+        }
+    }
+
+    std::int64_t size_in_bytes() const {
+        return file.size();
+    }
+
+    std::map<std::string, std::int64_t> space_breakdown() const {
+        std::map<std::string, std::int64_t> breakdown;
+        visit_sections([&](const hcs_section, const char* name, const packed_view& v) {
+            breakdown[name] = v.empty() ? 0 : mapped_padded_bytes(v.bit_size());
+        });
+
+        return breakdown;
+    }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file.
+class mapped_file {
+public:
+    mapped_file() {}
+
+    explicit mapped_file(const char* filename) {
+        const int fd = ::open(filename, O_RDONLY);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), std::string("cannot open ") + filename);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), std::string("cannot stat ") + filename);
+        }
+
+        m_size = st.st_size;
+        if (m_size) {
+            void* addr = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (addr == MAP_FAILED) {
+                const int err = errno;
+                ::close(fd);
+                throw std::system_error(err, std::generic_category(), std::string("cannot map ") + filename);
+            }
+            m_data = static_cast<const char*>(addr);
+        }
+        ::close(fd);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    mapped_file(mapped_file&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)),
+          m_size(std::exchange(other.m_size, 0)) {}
+
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+
+    ~mapped_file() {
+        if (m_data) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    // advice is one of the MADV_* access patterns of madvise
+    void advise(const int advice) const {
+        if (m_data) {
+            ::madvise(const_cast<char*>(m_data), m_size, advice);
+        }
+    }
+
+    const char* data() const {
+        return m_data;
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
@@ -0,0 +1,396 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <span>
+
+#include <cstdint>
+
+#include <sdsl/bits.hpp>
+
+#include "bit_kernels.hpp"
+
+// Compressed encodings of roots, used instead of the bitmap and the
+// fixed-width encoding when smaller. A coded root is the code in
+// root_code_bits bits, gamma codes of its universe (largest color + 1) and
+// of its number of colors, and the payload of the code:
+//
+//   elias_fano  low bits of every color, then the high parts in unary
+//   run_length  gamma code of the number of runs of consecutive colors,
+//               then per run the gap to the previous run + 1 and the length
+//   chunked     gamma code of the number of nonempty chunks of chunk_size
+//               colors, then per chunk the gap to the previous chunk, one
+//               bit for array or bitmap, and either the gamma coded number
+//               of colors followed by their offsets in the chunk or a bitmap
+//               of the chunk, whichever is smaller
+//
+// All fields are written least significant bit first.
+enum class root_code : std::uint8_t {
+    elias_fano,
+    run_length,
+    chunked
+};
+
+static constexpr root_code root_codes[] = {root_code::elias_fano, root_code::run_length, root_code::chunked};
+static constexpr std::size_t root_code_bits = 2;
+static constexpr std::size_t chunk_bits = 10;
+static constexpr std::size_t chunk_size = std::size_t(1) << chunk_bits;
+
+static inline const char* root_code_name(const root_code code) {
+    switch (code) {
+    case root_code::elias_fano:
+        return "elias_fano";
+    case root_code::run_length:
+        return "run_length";
+    default:
+        return "chunked";
+    }
+}
+
+static inline std::size_t gamma_bits(const std::uint64_t x) {
+    return 2 * std::bit_width(x) - 1;
+}
+
+static inline std::uint8_t elias_fano_low_bits(const std::size_t universe, const std::size_t count) {
+    return (universe > count) ? std::bit_width(universe / count) - 1 : 0;
+}
+
+// Sink of bit_stream_writer that only counts bits.
+struct bit_counter {
+    void set_int(const std::size_t, const std::uint64_t, const std::uint8_t) {}
+};
+
+// Writes fields at consecutive positions through a sink with the interface
+// of concurrent_bit_writer, whose bits are zero-initialized.
+template<typename Sink>
+class bit_stream_writer {
+public:
+    explicit bit_stream_writer(Sink& sink) : sink(sink) {}
+
+    void put(const std::uint64_t x, const std::uint8_t width) {
+        if (width) {
+            sink.set_int(pos, x, width);
+        }
+        pos += width;
+    }
+
+    // x >= 1, as n - 1 zeros, a one and the n - 1 low bits of x
+    void put_gamma(const std::uint64_t x) {
+        const std::uint8_t n = std::bit_width(x);
+        pos += n - 1;
+        put(1, 1);
+        put(x & sdsl::bits::lo_set[n - 1], n - 1);
+    }
+
+    // sets the bit at offset from the current position
+    void set(const std::size_t offset) {
+        sink.set_int(pos + offset, 1, 1);
+    }
+
+    void skip(const std::size_t bits) {
+        pos += bits;
+    }
+
+    std::size_t position() const {
+        return pos;
+    }
+
+private:
+    Sink& sink;
+    std::size_t pos = 0;
+};
+
+// Zero bits after the last field of a container read by bit_stream_reader,
+// as reads may touch the 64 bits after a field. An sdsl vector has no spare
+// word unless its size is a multiple of 64, so build_ds allocates the coded
+// containers with this padding; the mapped layout always has it.
+static constexpr std::size_t stream_padding_bits = 64;
+
+// Reads fields written by bit_stream_writer. Reads may touch the 64 bits
+// after the last field, see stream_padding_bits.
+class bit_stream_reader {
+public:
+    bit_stream_reader(const std::uint64_t* words, const std::size_t pos) : words(words), pos(pos) {}
+
+    std::uint64_t get(const std::uint8_t width) {
+        const std::uint64_t x = sdsl::bits::read_int(words + pos / 64, pos % 64, width);
+        pos += width;
+        return x;
+    }
+
+    std::uint64_t get_gamma() {
+        const std::uint8_t zeros = std::countr_zero(sdsl::bits::read_int(words + pos / 64, pos % 64, 64));
+        pos += zeros + 1;
+        return (1ull << zeros) | get(zeros);
+    }
+
+    std::size_t position() const {
+        return pos;
+    }
+
+private:
+    const std::uint64_t* words;
+    std::size_t pos;
+};
+
+// Calls f(begin, end) for every run of consecutive colors of cs.
+template<typename F>
+static void for_each_run(const std::span<const std::uint32_t> cs, F&& f) {
+    for (std::size_t i = 0; i < cs.size();) {
+        std::size_t j = i + 1;
+        while (j < cs.size() && cs[j] == cs[j - 1] + 1) {
+            ++j;
+        }
+        f(static_cast<std::size_t>(cs[i]), static_cast<std::size_t>(cs[j - 1]) + 1);
+        i = j;
+    }
+}
+
+// Calls f(chunk, first, last) for the colors cs[first:last] of every
+// nonempty chunk.
+template<typename F>
+static void for_each_chunk(const std::span<const std::uint32_t> cs, F&& f) {
+    for (std::size_t i = 0; i < cs.size();) {
+        const std::size_t chunk = cs[i] >> chunk_bits;
+        std::size_t j = i + 1;
+        while (j < cs.size() && (cs[j] >> chunk_bits) == chunk) {
+            ++j;
+        }
+        f(chunk, i, j);
+        i = j;
+    }
+}
+
+// Encodes the nonempty set cs with code.
+template<typename Writer>
+static void encode_root(const root_code code, const std::span<const std::uint32_t> cs, Writer& w) {
+    const std::size_t universe = static_cast<std::size_t>(cs.back()) + 1;
+    const std::size_t count = cs.size();
+
+    w.put(static_cast<std::uint64_t>(code), root_code_bits);
+    w.put_gamma(universe);
+    w.put_gamma(count);
+
+    if (code == root_code::elias_fano) {
+        const std::uint8_t l = elias_fano_low_bits(universe, count);
+        for (const auto x : cs) {
+            w.put(x & sdsl::bits::lo_set[l], l);
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            w.set((cs[i] >> l) + i);
+        }
+        w.skip(count + ((universe - 1) >> l));
+    } else if (code == root_code::run_length) {
+        std::size_t runs = 0;
+        for_each_run(cs, [&](std::size_t, std::size_t) { ++runs; });
+
+        w.put_gamma(runs);
+        std::size_t prev_end = 0;
+        for_each_run(cs, [&](const std::size_t begin, const std::size_t end) {
+            w.put_gamma(begin - prev_end + 1);
+            w.put_gamma(end - begin);
+            prev_end = end;
+        });
+    } else {
+        std::size_t chunks = 0;
+        for_each_chunk(cs, [&](std::size_t, std::size_t, std::size_t) { ++chunks; });
+
+        w.put_gamma(chunks);
+        std::size_t next_chunk = 0;
+        for_each_chunk(cs, [&](const std::size_t chunk, const std::size_t first, const std::size_t last) {
+            const std::size_t base = chunk * chunk_size;
+            const std::size_t bitmap_bits = std::min(chunk_size, universe - base);
+            const std::size_t array_bits = gamma_bits(last - first) + (last - first) * chunk_bits;
+
+            w.put_gamma(chunk - next_chunk + 1);
+            next_chunk = chunk + 1;
+
+            if (array_bits < bitmap_bits) {
+                w.put(0, 1);
+                w.put_gamma(last - first);
+                for (std::size_t k = first; k < last; ++k) {
+                    w.put(cs[k] - base, chunk_bits);
+                }
+            } else {
+                w.put(1, 1);
+                for (std::size_t k = first; k < last; ++k) {
+                    w.set(cs[k] - base);
+                }
+                w.skip(bitmap_bits);
+            }
+        });
+    }
+}
+
+static inline std::size_t coded_root_bits(const root_code code, const std::span<const std::uint32_t> cs) {
+    bit_counter counter;
+    bit_stream_writer<bit_counter> w(counter);
+    encode_root(code, cs, w);
+    return w.position();
+}
+
+struct coded_root_header {
+    root_code code;
+    std::size_t universe;
+    std::size_t count;
+    std::size_t payload;
+};
+
+static inline coded_root_header read_coded_root_header(const std::uint64_t* words, const std::size_t pos) {
+    bit_stream_reader r(words, pos);
+    coded_root_header h;
+    h.code = static_cast<root_code>(r.get(root_code_bits));
+    h.universe = r.get_gamma();
+    h.count = r.get_gamma();
+    h.payload = r.position();
+    return h;
+}
+
+static inline void set_bit_range(std::uint64_t* bv, std::size_t begin, const std::size_t end) {
+    while (begin < end) {
+        const std::size_t len = std::min<std::size_t>(64 - begin % 64, end - begin);
+        bv[begin / 64] |= sdsl::bits::lo_set[len] << (begin % 64);
+        begin += len;
+    }
+}
+
+// Sets the bits of the colors of a coded root in bv, which has at least
+// (universe + 63) / 64 words.
+static inline void decode_coded_root(const std::uint64_t* words, const coded_root_header& h, std::uint64_t* bv) {
+    bit_stream_reader r(words, h.payload);
+
+    if (h.code == root_code::elias_fano) {
+        const std::uint8_t l = elias_fano_low_bits(h.universe, h.count);
+        const std::size_t lows = h.payload;
+        const std::size_t highs = lows + h.count * l;
+
+        std::size_t i = 0;
+        for (std::size_t p = highs; i < h.count; p += 64) {
+            std::uint64_t word = sdsl::bits::read_int(words + p / 64, p % 64, 64);
+            while (word && i < h.count) {
+                const std::size_t high = p - highs + std::countr_zero(word) - i;
+                const std::size_t low_pos = lows + i * l;
+                const std::size_t x = (high << l) | sdsl::bits::read_int(words + low_pos / 64, low_pos % 64, l);
+                bv[x / 64] |= 1ull << (x % 64);
+                word &= word - 1;
+                ++i;
+            }
+        }
+    } else if (h.code == root_code::run_length) {
+        const std::size_t runs = r.get_gamma();
+        std::size_t prev_end = 0;
+        for (std::size_t k = 0; k < runs; ++k) {
+            const std::size_t begin = prev_end + r.get_gamma() - 1;
+            const std::size_t end = begin + r.get_gamma();
+            set_bit_range(bv, begin, end);
+            prev_end = end;
+        }
+    } else {
+        const std::size_t chunks = r.get_gamma();
+        std::size_t next_chunk = 0;
+        for (std::size_t c = 0; c < chunks; ++c) {
+            const std::size_t chunk = next_chunk + r.get_gamma() - 1;
+            const std::size_t base = chunk * chunk_size;
+            next_chunk = chunk + 1;
+
+            if (r.get(1) == 0) {
+                const std::size_t k = r.get_gamma();
+                for (std::size_t j = 0; j < k; ++j) {
+                    const std::size_t x = base + r.get(chunk_bits);
+                    bv[x / 64] |= 1ull << (x % 64);
+                }
+            } else {
+                // chunks are word aligned in bv
+                const std::size_t bitmap_bits = std::min(chunk_size, h.universe - base);
+                for (std::size_t off = 0; off < bitmap_bits; off += 64) {
+                    bv[(base + off) / 64] |= r.get(std::min<std::size_t>(64, bitmap_bits - off));
+                }
+            }
+        }
+    }
+}
+
+// Number of colors of a coded root smaller than color, or -1 if color is
+// not in the root. Scans the root up to color.
+static inline std::int64_t coded_root_rank(const std::uint64_t* words, const coded_root_header& h, const std::size_t color) {
+    if (color >= h.universe) {
+        return -1;
+    }
+
+    bit_stream_reader r(words, h.payload);
+
+    if (h.code == root_code::elias_fano) {
+        const std::uint8_t l = elias_fano_low_bits(h.universe, h.count);
+        const std::size_t lows = h.payload;
+        const std::size_t highs = lows + h.count * l;
+
+        std::size_t i = 0;
+        for (std::size_t p = highs; i < h.count; p += 64) {
+            std::uint64_t word = sdsl::bits::read_int(words + p / 64, p % 64, 64);
+            while (word && i < h.count) {
+                const std::size_t high = p - highs + std::countr_zero(word) - i;
+                const std::size_t low_pos = lows + i * l;
+                const std::size_t x = (high << l) | sdsl::bits::read_int(words + low_pos / 64, low_pos % 64, l);
+                if (x >= color) {
+                    return (x == color) ? static_cast<std::int64_t>(i) : -1;
+                }
+                word &= word - 1;
+                ++i;
+            }
+        }
+    } else if (h.code == root_code::run_length) {
+        const std::size_t runs = r.get_gamma();
+        std::size_t prev_end = 0;
+        std::size_t rank = 0;
+        for (std::size_t k = 0; k < runs; ++k) {
+            const std::size_t begin = prev_end + r.get_gamma() - 1;
+            const std::size_t end = begin + r.get_gamma();
+            if (color < begin) {
+                return -1;
+            }
+            if (color < end) {
+                return rank + (color - begin);
+            }
+            rank += end - begin;
+            prev_end = end;
+        }
+    } else {
+        const std::size_t chunks = r.get_gamma();
+        std::size_t next_chunk = 0;
+        std::size_t rank = 0;
+        for (std::size_t c = 0; c < chunks; ++c) {
+            const std::size_t chunk = next_chunk + r.get_gamma() - 1;
+            const std::size_t base = chunk * chunk_size;
+            next_chunk = chunk + 1;
+
+            if (chunk > (color >> chunk_bits)) {
+                return -1;
+            }
+
+            if (r.get(1) == 0) {
+                const std::size_t k = r.get_gamma();
+                for (std::size_t j = 0; j < k; ++j) {
+                    const std::size_t x = base + r.get(chunk_bits);
+                    if (x >= color) {
+                        return (x == color) ? static_cast<std::int64_t>(rank) : -1;
+                    }
+                    ++rank;
+                }
+            } else {
+                const std::size_t bitmap_bits = std::min(chunk_size, h.universe - base);
+                const std::size_t bitmap = r.position();
+                if (chunk == (color >> chunk_bits)) {
+                    const std::size_t pos = bitmap + (color - base);
+                    if (!((words[pos / 64] >> (pos % 64)) & 1)) {
+                        return -1;
+                    }
+                    return rank + popcount_range(words, bitmap, pos);
+                }
+                rank += popcount_range(words, bitmap, bitmap + bitmap_bits);
+                r = bit_stream_reader(words, bitmap + bitmap_bits);
+            }
+        }
+    }
+
+    return -1;
+}
@@ -1,68 +1,386 @@
 #include <algorithm>
 #include <fstream>
-#include <functional>
 #include <iostream>
-#include <tuple>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <cstdint>
+#include <cstdio>
 
-template<typename T>
-std::vector<std::tuple<std::size_t, std::size_t>> get_color_set_lengths_and_indices(const char* input_filename) {
-    std::vector<std::tuple<std::size_t, std::size_t>> cs_indices;
-
-    std::ifstream ifs(input_filename, std::ios::binary);
-    const auto begin = ifs.tellg();
-    ifs.seekg(0, std::ios::end);
-    const auto end = ifs.tellg();
-    const std::size_t file_length = end - begin;
-    ifs.seekg(0);
-    const std::size_t text_length = file_length / sizeof(T);
-
-    std::size_t i = 0;
-    while (i < text_length) {
-        std::size_t cs_sz = 0;
-        ifs.read(reinterpret_cast<char*>(&cs_sz), sizeof(T));
-        cs_indices.push_back({cs_sz, i});
-        ++i;
-        T elem = 0;
-        for (std::size_t j = 0; j < cs_sz; ++j) {
-            ifs.read(reinterpret_cast<char*>(&elem), sizeof(T));
-            ++i;
+#include <sys/resource.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "color_sets.hpp"
+
+static void write_order(const char* order_filename, const std::vector<std::int64_t>& order) {
+    std::ofstream order_ofs(order_filename, std::ios::binary);
+    for (const auto original_idx : order) {
+        order_ofs.write(reinterpret_cast<const char*>(&original_idx), sizeof(original_idx));
+    }
+    order_ofs.close();
+}
+
+// Writes the color sets in ascending order of size and, if order_filename
+// is given, the input id of each written set as an int64.
+void write_sets_asc(const char* input_filename, const char* output_filename, const char* order_filename) {
+    color_set_collection color_sets(input_filename);
+
+    // sets are indexed in input order, so the index of a set is its input id
+    const auto order = order_by_size(color_sets);
+    color_sets.reorder(order);
+    write_color_sets(output_filename, color_sets);
+
+    if (order_filename) {
+        write_order(order_filename, order);
+    }
+}
+
+// A run file holds the sets of a range of sizes in input order, each as
+// the input id (two words, low first) followed by the set in the binary
+// format.
+struct bucket {
+    std::uint32_t min_size;
+    std::uint32_t max_size;
+    std::size_t words;
+    std::string filename;
+};
+
+static constexpr std::size_t run_header_words = 2;
+
+// Most run files open at once while distributing, the buffer of each and
+// the words of the input read at once. They are taken from the memory
+// budget before the runs are sized.
+static constexpr std::size_t max_open_runs = 64;
+static constexpr std::size_t run_buffer_bytes = std::size_t(1) << 13;
+static constexpr std::size_t input_block_words = std::size_t(1) << 16;
+
+// Run files open at once, at most half of the file descriptor limit but
+// at least two, so that distribute splits the buckets.
+static std::size_t open_run_limit() {
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        return std::clamp<std::size_t>(limit.rlim_cur / 2, 2, max_open_runs);
+    }
+
+    return max_open_runs;
+}
+
+static void check_run(const std::ios& stream, const char* action, const std::string& filename) {
+    if (!stream) {
+        throw std::runtime_error(std::string("cannot ") + action + " run file " + filename);
+    }
+}
+
+// Reads the records of a run file in order.
+class run_reader {
+public:
+    explicit run_reader(const std::string& filename) : filename(filename), ifs(filename, std::ios::binary) {
+        check_run(ifs, "open", filename);
+    }
+
+    // Reads the next record into original_idx and cs, which stays valid
+    // until the next call. Returns false at the end of the file.
+    bool next(std::uint64_t& original_idx, color_set_reader::set_type& cs) {
+        std::uint32_t header[run_header_words + 1];
+        if (!ifs.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            if (ifs.gcount() == 0 && ifs.eof()) {
+                return false;
+            }
+            check_run(ifs, "read", filename);
         }
+
+        set.resize(header[run_header_words]);
+        ifs.read(reinterpret_cast<char*>(set.data()), set.size() * sizeof(std::uint32_t));
+        check_run(ifs, "read", filename);
+
+        original_idx = header[0] | (static_cast<std::uint64_t>(header[1]) << 32);
+        cs = set;
+        return true;
     }
+
+private:
+    std::string filename;
+    std::ifstream ifs;
+    std::vector<std::uint32_t> set;
+};
+
+using bucket_range = std::pair<std::size_t, std::size_t>;
+
+// Run file of the buckets [first, last) of a range.
+static std::string range_filename(const std::vector<bucket>& buckets, const bucket_range& range, const std::string& run_prefix) {
+    if (range.second - range.first == 1) {
+        return buckets[range.first].filename;
+    }
+
+    return run_prefix + ".runs" + std::to_string(range.first) + "-" + std::to_string(range.second - 1);
+}
+
+// Distributes the records returned by next into the run files of
+// buckets[first, last) in one pass. With more buckets than open_runs, the
+// records go to open_runs files of ranges of consecutive buckets instead,
+// which are returned to be split the same way in turn, so that the input
+// is read once. Every file keeps the records in input order.
+template<typename Next>
+static std::vector<bucket_range> distribute(Next&& next,
+                       const std::vector<bucket>& buckets,
+                       const std::vector<std::size_t>& bucket_of,
+                       const std::size_t first,
+                       const std::size_t last,
+                       const std::size_t open_runs,
+                       const std::string& run_prefix) {
+    // [first bucket, last bucket) of every file, with the buckets spread
+    // evenly so that every level of splitting divides them by open_runs
+    const std::size_t count = last - first;
+    const std::size_t group_count = std::min(count, open_runs);
+    std::vector<bucket_range> groups(group_count, {last, first});
+    std::vector<std::size_t> group_of(count);
+    for (std::size_t b = first; b < last; ++b) {
+        const std::size_t g = (b - first) * group_count / count;
+        groups[g].first = std::min(groups[g].first, b);
+        groups[g].second = b + 1;
+        group_of[b - first] = g;
+    }
+
+    const auto filename_of = [&](const bucket_range& g) {
+        return range_filename(buckets, g, run_prefix);
+    };
+
+    {
+        std::vector<std::vector<char>> buffers(groups.size(), std::vector<char>(run_buffer_bytes));
+        std::vector<std::ofstream> runs(groups.size());
+        for (std::size_t g = 0; g < groups.size(); ++g) {
+            runs[g].rdbuf()->pubsetbuf(buffers[g].data(), run_buffer_bytes);
+            runs[g].open(filename_of(groups[g]), std::ios::binary);
+            check_run(runs[g], "open", filename_of(groups[g]));
+        }
+
+        std::uint64_t original_idx = 0;
+        color_set_reader::set_type cs;
+        while (next(original_idx, cs)) {
+            const std::size_t g = group_of[bucket_of[cs.size()] - first];
+            const std::uint32_t header[run_header_words + 1] = {
+                static_cast<std::uint32_t>(original_idx),
+                static_cast<std::uint32_t>(original_idx >> 32),
+                static_cast<std::uint32_t>(cs.size())
+            };
+            runs[g].write(reinterpret_cast<const char*>(header), sizeof(header));
+            runs[g].write(reinterpret_cast<const char*>(cs.data()), cs.size() * sizeof(std::uint32_t));
+            check_run(runs[g], "write", filename_of(groups[g]));
+        }
+
+        for (std::size_t g = 0; g < groups.size(); ++g) {
+            runs[g].close();
+            check_run(runs[g], "write", filename_of(groups[g]));
+        }
+    }
+
+    std::erase_if(groups, [](const bucket_range& g) { return g.second - g.first == 1; });
+    return groups;
+}
+
+// Loads a run file and returns its records stably sorted by set size.
+static std::vector<std::uint32_t> sort_run(const bucket& b) {
+    std::vector<std::uint32_t> run(b.words);
+    std::ifstream ifs(b.filename, std::ios::binary);
+    check_run(ifs, "open", b.filename);
+    ifs.read(reinterpret_cast<char*>(run.data()), run.size() * sizeof(std::uint32_t));
+    check_run(ifs, "read", b.filename);
     ifs.close();
 
-    return cs_indices;
+    std::vector<std::size_t> records;
+    for (std::size_t i = 0; i < run.size(); i += run_header_words + run[i + run_header_words] + 1) {
+        records.push_back(i);
+    }
+    std::stable_sort(records.begin(), records.end(), [&](const std::size_t a, const std::size_t b) {
+        return run[a + run_header_words] < run[b + run_header_words];
+    });
+
+    std::vector<std::uint32_t> sorted;
+    sorted.reserve(run.size());
+    for (const auto r : records) {
+        sorted.insert(sorted.end(), run.begin() + r, run.begin() + r + run_header_words + run[r + run_header_words] + 1);
+    }
+
+    return sorted;
 }
 
-template<typename T>
-void write_sets_asc(const char* input_filename, const char* output_filename) {
-    std::ifstream ifs(input_filename, std::ios::binary);
+// Appends the records of a sorted run to the output and order files.
+static void emit_run(const std::vector<std::uint32_t>& run, std::ofstream& ofs, std::ofstream& order_ofs) {
+    for (std::size_t i = 0; i < run.size();) {
+        const std::int64_t original_idx = run[i] | (static_cast<std::int64_t>(run[i + 1]) << 32);
+        const std::size_t record_words = run_header_words + run[i + run_header_words] + 1;
+        ofs.write(reinterpret_cast<const char*>(run.data() + i + run_header_words), (record_words - run_header_words) * sizeof(std::uint32_t));
+        if (order_ofs.is_open()) {
+            order_ofs.write(reinterpret_cast<const char*>(&original_idx), sizeof(original_idx));
+        }
+        i += record_words;
+    }
+}
+
+// Same output as write_sets_asc without random accesses to the input. The
+// sets are distributed by distribute in one sequential pass over the input
+// into run files covering ranges of sizes small enough to be sorted within
+// the memory budget, and the runs are then sorted in parallel and appended
+// in order of size.
+void write_sets_asc_external(const char* input_filename,
+                             const char* output_filename,
+                             const char* order_filename,
+                             const std::size_t memory_budget,
+                             const std::string& run_prefix) {
+    color_set_reader::set_type cs;
+
+    std::cout << "Computing size histogram\n";
+
+    std::vector<std::size_t> size_words;
+    {
+        color_set_reader reader(input_filename, input_block_words);
+        while (reader.next(cs)) {
+            if (size_words.size() <= cs.size()) {
+                size_words.resize(cs.size() + 1, 0);
+            }
+            size_words[cs.size()] += run_header_words + cs.size() + 1;
+        }
+    }
+
+#ifdef _OPENMP
+    const std::size_t threads = omp_get_max_threads();
+#else
+    const std::size_t threads = 1;
+#endif
+
+    // a run and its sorted copy are in memory for every thread
+    const std::size_t reserved = max_open_runs * run_buffer_bytes + input_block_words * sizeof(std::uint32_t);
+    const std::size_t run_budget = std::max<std::size_t>((memory_budget - std::min(memory_budget, reserved)) / (2 * threads * sizeof(std::uint32_t)), 1);
+
+    std::vector<bucket> buckets;
+    std::vector<std::size_t> bucket_of(size_words.size(), 0);
+    for (std::size_t sz = 0; sz < size_words.size(); ++sz) {
+        if (size_words[sz] == 0) {
+            continue;
+        }
+        if (buckets.empty() || buckets.back().words + size_words[sz] > run_budget) {
+            buckets.push_back({static_cast<std::uint32_t>(sz), static_cast<std::uint32_t>(sz), 0,
+                               run_prefix + ".run" + std::to_string(buckets.size())});
+        }
+        buckets.back().max_size = sz;
+        buckets.back().words += size_words[sz];
+        bucket_of[sz] = buckets.size() - 1;
+    }
+
+    std::cout << "Distributing sets into " << buckets.size() << " runs\n";
+
+    // one file is read at a time, so at most open_runs + 1 are open
+    const std::size_t open_runs = open_run_limit();
+    std::vector<bucket_range> ranges;
+    if (!buckets.empty()) {
+        color_set_reader reader(input_filename, input_block_words);
+        std::uint64_t next_idx = 0;
+        ranges = distribute([&](std::uint64_t& original_idx, color_set_reader::set_type& set) {
+                                original_idx = next_idx++;
+                                return reader.next(set);
+                            },
+                            buckets, bucket_of, 0, buckets.size(), open_runs, run_prefix);
+    }
+
+    while (!ranges.empty()) {
+        const auto range = ranges.back();
+        ranges.pop_back();
+
+        const auto filename = range_filename(buckets, range, run_prefix);
+        std::vector<bucket_range> split;
+        {
+            run_reader reader(filename);
+            split = distribute([&](std::uint64_t& original_idx, color_set_reader::set_type& set) {
+                                   return reader.next(original_idx, set);
+                               },
+                               buckets, bucket_of, range.first, range.second, open_runs, run_prefix);
+        }
+        std::remove(filename.c_str());
+        ranges.insert(ranges.end(), split.begin(), split.end());
+    }
+
+    std::cout << "Sorting runs\n";
+
     std::ofstream ofs(output_filename, std::ios::binary);
+    std::ofstream order_ofs;
+    if (order_filename) {
+        order_ofs.open(order_filename, std::ios::binary);
+    }
+
+    for (std::size_t first = 0; first < buckets.size(); first += threads) {
+        const std::size_t last = std::min(first + threads, buckets.size());
+        std::vector<std::vector<std::uint32_t>> sorted(last - first);
 
-    auto len_idx_vec = get_color_set_lengths_and_indices<std::uint32_t>(input_filename);
-    std::sort(len_idx_vec.begin(), len_idx_vec.end(), std::less<std::tuple<std::size_t, std::size_t>>());
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (std::size_t b = first; b < last; ++b) {
+            // a run of one size is already in input order and may exceed
+            // the budget, so it is streamed below instead
+            if (buckets[b].min_size != buckets[b].max_size) {
+                sorted[b - first] = sort_run(buckets[b]);
+            }
+        }
 
-    for (std::size_t i = 0; i < len_idx_vec.size(); ++i) {
-        const auto& [len, idx] = len_idx_vec[i];
-        ifs.seekg(idx * sizeof(T));
-        T color_set_sz = 0;
-        ifs.read(reinterpret_cast<char*>(&color_set_sz), sizeof(T));
-        std::vector<T> color_set(color_set_sz, 0);
-        ifs.read(reinterpret_cast<char*>(color_set.data()), sizeof(T) * color_set_sz);
-        ofs.write(reinterpret_cast<char*>(&color_set_sz), sizeof(T));
-        ofs.write(reinterpret_cast<char*>(color_set.data()), sizeof(T) * color_set_sz);
+        for (std::size_t b = first; b < last; ++b) {
+            if (buckets[b].min_size != buckets[b].max_size) {
+                emit_run(sorted[b - first], ofs, order_ofs);
+                sorted[b - first] = std::vector<std::uint32_t>();
+            } else {
+                std::ifstream run(buckets[b].filename, std::ios::binary);
+                check_run(run, "open", buckets[b].filename);
+                const std::size_t record_words = run_header_words + buckets[b].min_size + 1;
+                std::vector<std::uint32_t> block(std::max<std::size_t>(run_budget / record_words, 1) * record_words);
+                for (std::size_t left = buckets[b].words; left > 0;) {
+                    const std::size_t n = std::min(left, block.size());
+                    block.resize(n);
+                    run.read(reinterpret_cast<char*>(block.data()), n * sizeof(std::uint32_t));
+                    check_run(run, "read", buckets[b].filename);
+                    emit_run(block, ofs, order_ofs);
+                    left -= n;
+                }
+            }
+            std::remove(buckets[b].filename.c_str());
+        }
     }
-    ifs.close();
+
     ofs.close();
+    if (order_ofs.is_open()) {
+        order_ofs.close();
+    }
 }
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::fprintf(stderr, "usage: %s [input file] [output file]\n", argv[0]);
+    const char* order_filename = nullptr;
+    std::size_t memory_budget = 0;
+    std::string run_prefix;
+
+    bool valid = argc >= 3;
+    for (int i = 3; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--memory" && i + 1 < argc) {
+            memory_budget = std::stoull(argv[++i]) << 20;
+        } else if (arg == "--tmp" && i + 1 < argc) {
+            run_prefix = argv[++i];
+        } else if (!order_filename && arg.rfind("--", 0) != 0) {
+            order_filename = argv[i];
+        } else {
+            valid = false;
+        }
+    }
+
+    if (!valid) {
+        std::fprintf(stderr, "usage: %s [input file] [output file] [order file] [--memory MiB] [--tmp run file prefix]\n", argv[0]);
         std::exit(EXIT_FAILURE);
     }
 
-    write_sets_asc<std::uint32_t>(argv[1], argv[2]);
+    if (memory_budget) {
+        write_sets_asc_external(argv[1], argv[2], order_filename, memory_budget,
+                                run_prefix.empty() ? std::string(argv[2]) : run_prefix);
+    } else {
+        write_sets_asc(argv[1], argv[2], order_filename);
+    }
 }
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <span>
+#include <vector>
+
+#include <cstdint>
+
+#include <sdsl/bits.hpp>
+
+#include "root_codes.hpp"
+
+// Compressed encoding of the bits of a subset, used instead of one bit per
+// element of the parent when smaller, i.e. for nearly empty and nearly full
+// subsets. A coded subset is a complement bit, the gamma code of the size of
+// its parent and the ascending positions among the elements of the parent
+// of either its elements or, if complemented, the elements of the parent
+// not in it, each in subset_position_bits(parent size) bits. The number of
+// positions follows from the length of the range of the subset.
+
+static inline std::uint8_t subset_position_bits(const std::size_t parent_size) {
+    return std::max<std::size_t>(std::bit_width(parent_size - 1), 1);
+}
+
+static inline std::size_t coded_subset_bits(const std::size_t parent_size, const std::size_t size) {
+    const std::size_t listed = std::min(size, parent_size - size);
+    return 1 + gamma_bits(parent_size) + listed * subset_position_bits(parent_size);
+}
+
+// cs is a subset of parent, both ascending
+template<typename Writer>
+static void encode_subset(const std::span<const std::uint32_t> parent,
+                          const std::span<const std::uint32_t> cs,
+                          Writer& w) {
+    const bool complement = cs.size() > parent.size() - cs.size();
+    const std::uint8_t width = subset_position_bits(parent.size());
+
+    w.put(complement, 1);
+    w.put_gamma(parent.size());
+    for (std::size_t m = 0, k = 0; m < parent.size(); ++m) {
+        const bool in_subset = k < cs.size() && parent[m] == cs[k];
+        k += in_subset;
+        if (in_subset != complement) {
+            w.put(m, width);
+        }
+    }
+}
+
+struct coded_subset_header {
+    bool complement;
+    std::size_t parent_size;
+    std::uint8_t width;
+    std::size_t positions;
+    std::size_t count;
+
+    std::size_t position(const std::uint64_t* words, const std::size_t j) const {
+        const std::size_t pos = positions + j * width;
+        return sdsl::bits::read_int(words + pos / 64, pos % 64, width);
+    }
+
+    std::size_t cardinality() const {
+        return complement ? parent_size - count : count;
+    }
+};
+
+// header of the coded subset in bits [beg, end) of words
+static inline coded_subset_header read_coded_subset_header(const std::uint64_t* words,
+                                                           const std::size_t beg,
+                                                           const std::size_t end) {
+    bit_stream_reader r(words, beg);
+    coded_subset_header h;
+    h.complement = r.get(1);
+    h.parent_size = r.get_gamma();
+    h.width = subset_position_bits(h.parent_size);
+    h.positions = r.position();
+    h.count = (end - h.positions) / h.width;
+    return h;
+}
+
+// Writes the plain bits of the coded subset to mask, one per element of the
+// parent, so that it is applied to the parent with deposit_subset.
+static inline void expand_coded_subset(const std::uint64_t* subset,
+                                       const coded_subset_header& h,
+                                       std::vector<std::uint64_t>& mask) {
+    // one extra word for reads crossing the end of the last word
+    mask.assign(h.parent_size / 64 + 2, h.complement ? ~0ull : 0ull);
+    for (std::size_t j = 0; j < h.count; ++j) {
+        const std::size_t q = h.position(subset, j);
+        mask[q / 64] ^= 1ull << (q % 64);
+    }
+}
+
+// Number of elements of the coded subset before position p of its parent,
+// or -1 if the element at p is not in the subset.
+static inline std::int64_t coded_subset_rank(const std::uint64_t* subset,
+                                             const coded_subset_header& h,
+                                             const std::size_t p) {
+    std::size_t lo = 0;
+    std::size_t hi = h.count;
+    while (lo < hi) {
+        const std::size_t mid = lo + (hi - lo) / 2;
+        if (h.position(subset, mid) < p) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    const bool listed = lo < h.count && h.position(subset, lo) == p;
+    if (h.complement) {
+        return listed ? -1 : static_cast<std::int64_t>(p - lo);
+    }
+
+    return listed ? static_cast<std::int64_t>(lo) : -1;
+}
@@ -1,46 +1,39 @@
-#include "hcs_construction.hpp"
-
-void top_down_limit(const std::vector<std::vector<std::uint32_t>>& color_sets,
-                    std::vector<std::int64_t>& parent_vec,
-                    const std::int64_t depth_limit) {
-    std::vector<std::int64_t> depth_vec(color_sets.size(), -1);
-
-    for (std::int64_t i = 0; i < color_sets.size(); ++i) {
-        if (depth_vec[i] == -1) {
-            std::vector<std::int64_t> st;
-            st.push_back(i);
-
-            std::int64_t parent = parent_vec[i];
-            while (parent != -1) {
-                st.push_back(parent);
-                parent = parent_vec[parent];
-            }
+#include <string>
 
-            const std::int64_t root = st.back();
-            std::int64_t depth = 0;
+#include "depth_limits.hpp"
+#include "hcs_construction.hpp"
 
-            while (st.size()) {
-                if (depth > depth_limit) {
-                    parent_vec[st.back()] = root;
-                    depth = 1;
-                }
+int main(int argc, char* argv[]) {
+    build_options options;
+    const char* order_filename = nullptr;
 
-                const auto top = st.back(); st.pop_back();
-                depth_vec[top] = depth++;
-            }
+    bool valid = argc >= 5;
+    for (int i = 5; valid && i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--skip-budget" && i + 1 < argc) {
+            options.skip_budget = std::stoull(argv[++i]);
+        } else if (arg == "--layout" && i + 1 < argc) {
+            valid = parse_id_layout(argv[++i], options.layout);
+        } else if (arg == "--no-coded-roots") {
+            options.coded_roots = false;
+        } else if (arg == "--no-coded-subsets") {
+            options.coded_subsets = false;
+        } else if (!order_filename && arg.rfind("--", 0) != 0) {
+            order_filename = argv[i];
+        } else {
+            valid = false;
         }
     }
-}
 
-int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        std::fprintf(stderr, "usage: %s [color sets file] [parents file] [depth limit] [output file]\n", argv[0]);
+    if (!valid) {
+        std::fprintf(stderr, "usage: %s [color sets file] [parents file] [depth limit] [output file] [order file] [--skip-budget bytes] [--layout input|dfs|bfs] [--no-coded-roots] [--no-coded-subsets]\n", argv[0]);
         std::exit(EXIT_FAILURE);
     }
 
-    const auto color_sets = get_color_sets<std::uint32_t>(argv[1]);
+    const color_set_collection color_sets(argv[1]);
     auto parents = get_parents<std::int64_t>(argv[2]);
     const std::int32_t depth_limit = std::stoi(argv[3]);
+    const auto order = order_filename ? get_order<std::int64_t>(order_filename) : std::vector<std::int64_t>();
 
     std::cout << "Computing depths\n";
     top_down_limit(color_sets, parents, depth_limit);
@@ -57,15 +50,22 @@ int main(int argc, char* argv[]) {
     std::cout << "depth limit: " << depth_limit << "\n";
     std::cout << "encoding width: " << enc_width << "\n";
 
-    const auto [d, m] = build_ds(color_sets, parents, enc_width);
+    auto [d, m] = build_ds(color_sets, parents, enc_width, options);
+    d.id_map = build_id_map(m, order);
 
     std::cout << "d.dense_container.size() "  << d.dense_container.size()  << "\n";
     std::cout << "d.dense_starts.size() "     << d.dense_starts.size()     << "\n";
     std::cout << "d.sparse_container.size() " << d.sparse_container.size() << "\n";
     std::cout << "d.sparse_starts.size() "    << d.sparse_starts.size()    << "\n";
+    std::cout << "d.coded_container.size() "  << d.coded_container.size()  << "\n";
+    std::cout << "d.coded_starts.size() "     << d.coded_starts.size()     << "\n";
+    std::cout << "d.coded_subsets.size() "    << d.coded_subsets.size()    << "\n";
+    std::cout << "d.skip_container.size() "   << d.skip_container.size()   << "\n";
+    std::cout << "d.skip_starts.size() "      << d.skip_starts.size()      << "\n";
     std::cout << "d.subset_container.size() " << d.subset_container.size() << "\n";
     std::cout << "d.subset_starts.size() "    << d.subset_starts.size()    << "\n";
     std::cout << "d.parent_vec.size() "    << d.parent_vec.size()    << "\n";
+    std::cout << "d.id_map.size() "        << d.id_map.size()        << "\n";
     std::cout << "\n";
     std::cout << "size in bytes: " << d.size_in_bytes() << "\n";
 